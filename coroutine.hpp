@@ -0,0 +1,289 @@
+#ifndef PAD_COROUTINE_H
+#define PAD_COROUTINE_H
+
+#include <sys/epoll.h>
+
+#include <cerrno>
+
+#include "gamepad.hpp"
+
+namespace pad {
+
+  /**
+   * @brief object notified when a watched fd becomes readable
+   *
+   */
+  class FdWatcher {
+   public:
+    virtual ~FdWatcher() = default;
+    virtual void onReadable() = 0;
+  };
+
+  /**
+   * @brief interface of the loop that watches fds (implement this to use an external loop)
+   *
+   * `onReadable()` must be called on the loop thread while the watch is registered
+   */
+  class EventScheduler {
+   public:
+    virtual ~EventScheduler() = default;
+    virtual bool addWatch(int fd, FdWatcher* watcher) = 0;
+    virtual void removeWatch(int fd) = 0;
+  };
+
+  /**
+   * @brief small epoll based loop, watchers are called on the thread running `run()`
+   *
+   */
+  class EventLoop: public EventScheduler {
+   private:
+    int epoll_fd_;
+    int watch_count_{0};
+    bool running_{false};
+
+   public:
+    EventLoop():
+      epoll_fd_(epoll_create1(EPOLL_CLOEXEC))
+    {
+
+    }
+
+    ~EventLoop() {
+      if (this->epoll_fd_ >= 0) {
+        close(this->epoll_fd_);
+      }
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool addWatch(int fd, FdWatcher* watcher) override {
+      epoll_event event;
+      memset(&event, 0, sizeof(event));
+      event.events = EPOLLIN;
+      event.data.ptr = watcher;
+
+      if (epoll_ctl(this->epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+        return false;
+      }
+
+      this->watch_count_++;
+      return true;
+    }
+
+    void removeWatch(int fd) override {
+      if (epoll_ctl(this->epoll_fd_, EPOLL_CTL_DEL, fd, nullptr) == 0) {
+        this->watch_count_--;
+      }
+    }
+
+    /**
+     * @brief wait up to `timeout_ms` (-1: infinite) and call watchers of readable fds
+     *
+     * @return number of watchers called, -1 on error
+     */
+    int runOnce(int timeout_ms = -1) {
+      epoll_event events[MAX_EVENTS];
+      int num = epoll_wait(this->epoll_fd_, events, MAX_EVENTS, timeout_ms);
+
+      for (int i = 0; i < num; i++) {
+        // EPOLLHUP / EPOLLERR も通知し，read() で切断を検出させる
+        static_cast<FdWatcher*>(events[i].data.ptr)->onReadable();
+      }
+
+      return num;
+    }
+
+    /**
+     * @brief run until `stop()` is called or no fd is watched
+     *
+     */
+    void run() {
+      this->running_ = true;
+      while (this->running_ && this->watch_count_ > 0) {
+        if (runOnce() < 0 && errno != EINTR) {
+          break;
+        }
+      }
+      this->running_ = false;
+    }
+
+    void stop() {
+      this->running_ = false;
+    }
+  };
+}
+
+// コルーチン API は C++20 でコンパイルした場合のみ有効
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <exception>
+
+namespace pad {
+
+  /**
+   * @brief fire-and-forget coroutine, starts immediately and frees itself on completion
+   *
+   */
+  struct Task {
+    struct promise_type {
+      Task get_return_object() { return {}; }
+      std::suspend_never initial_suspend() noexcept { return {}; }
+      std::suspend_never final_suspend() noexcept { return {}; }
+      void return_void() {}
+      void unhandled_exception() { std::terminate(); }
+    };
+  };
+
+  /**
+   * @brief pad whose input can be awaited from coroutines
+   *
+   * the device fd is watched through `scheduler` only while some coroutine is waiting.
+   * each time it becomes readable `update()` is called once and waiting coroutines whose
+   * condition holds are resumed directly on the loop thread.
+   * every awaitable resumes with `false` when the pad is disconnected.
+   *
+   * @note do not enable `RealtimeConfig::reader_thread`, the fd must be read by `update()`
+   */
+  template <typename Handler,
+    typename = std::enable_if_t<std::is_base_of<PadEventHandler, Handler>::value>>
+  class AsyncPad: public BasePad<Handler>, private FdWatcher {
+   private:
+    enum class WaitType : uint8_t {
+      Frame,
+      Push,
+      Cross
+    };
+
+    // 待機中のコルーチン (awaiter 自身をつなぐリストで，メモリ確保なし)
+    struct Waiter {
+      AsyncPad* pad;
+      WaitType  type;
+      uint8_t   id;
+      float     threshold;
+      bool      above;
+      bool      result;
+      std::coroutine_handle<> handle;
+      Waiter*   next;
+
+      bool await_ready() {
+        if (!this->pad->isConnected()) {
+          this->result = false;
+          return true;
+        }
+        if (this->type == WaitType::Cross) {
+          this->above = this->pad->axisValue(this->id) >= this->threshold;
+        }
+        return false;
+      }
+
+      void await_suspend(std::coroutine_handle<> handle) {
+        this->handle = handle;
+        this->pad->addWaiter(this);
+      }
+
+      bool await_resume() {
+        return this->result;
+      }
+    };
+
+    EventScheduler& scheduler_;
+    Waiter* waiters_{nullptr};
+    bool watching_{false};
+
+    void addWaiter(Waiter* waiter) {
+      waiter->next = this->waiters_;
+      this->waiters_ = waiter;
+
+      if (!this->watching_) {
+        this->watching_ = this->scheduler_.addWatch(this->getFd(), this);
+      }
+    }
+
+    bool satisfied(Waiter* waiter, bool new_frame) {
+      switch (waiter->type) {
+        case WaitType::Frame: return new_frame;
+        case WaitType::Push:  return this->pushed(waiter->id);
+        case WaitType::Cross: return (this->axisValue(waiter->id) >= waiter->threshold) != waiter->above;
+      }
+      return false;
+    }
+
+    void onReadable() override {
+      uint64_t num_events = this->getMetrics().events;
+      this->update();
+      bool new_frame = this->getMetrics().events != num_events;
+      bool connected = this->isConnected();
+
+      // 再開したコルーチンが続けて待機しても今回の判定に混ざらないよう，リストを切り離して処理する
+      Waiter* waiter = this->waiters_;
+      this->waiters_ = nullptr;
+
+      while (waiter != nullptr) {
+        Waiter* next = waiter->next;
+
+        if (!connected || satisfied(waiter, new_frame)) {
+          waiter->result = connected;
+          waiter->handle.resume();
+        }
+        else {
+          waiter->next = this->waiters_;
+          this->waiters_ = waiter;
+        }
+
+        waiter = next;
+      }
+
+      if (this->watching_ && (this->waiters_ == nullptr || !this->isConnected())) {
+        this->scheduler_.removeWatch(this->getFd());
+        this->watching_ = false;
+      }
+    }
+
+   public:
+    AsyncPad(std::string devfile_path,
+             EventScheduler& scheduler,
+             int button_num = DEFAULT_BUTTON_NUM,
+             int axis_num = DEFALUT_AXIS_NUM):
+      BasePad<Handler>(devfile_path, button_num, axis_num),
+      scheduler_(scheduler)
+    {
+
+    }
+
+    ~AsyncPad() {
+      if (this->watching_) {
+        this->scheduler_.removeWatch(this->getFd());
+      }
+    }
+
+    /**
+     * @brief resume after the next `update()` that read at least one event
+     *
+     */
+    Waiter nextFrame() {
+      return Waiter{this, WaitType::Frame, 0, 0.0f, false, true, nullptr, nullptr};
+    }
+
+    /**
+     * @brief resume when button `id` is pushed
+     *
+     */
+    Waiter nextPush(uint8_t id) {
+      return Waiter{this, WaitType::Push, id, 0.0f, false, true, nullptr, nullptr};
+    }
+
+    /**
+     * @brief resume when axis `id` crosses `threshold` (either direction) from its current value
+     *
+     */
+    Waiter axisCrosses(uint8_t id, float threshold) {
+      return Waiter{this, WaitType::Cross, id, threshold, false, true, nullptr, nullptr};
+    }
+  };
+}
+
+#endif // __cplusplus >= 202002L
+
+#endif // PAD_COROUTINE_H
@@ -0,0 +1,341 @@
+#include "feedback.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+namespace pad {
+
+  FeedbackQueue::FeedbackQueue() {
+    for (int i = 0; i < MAX_FF_EFFECTS; i++) {
+      this->effect_ids_[i] = -1;
+    }
+  }
+
+  FeedbackQueue::~FeedbackQueue() { close(); }
+
+  /**
+   * @brief open device file for writing force feedback and start worker thread
+   *
+   * @retval `true`: succeed in opening device file
+   * @retval `false`: fail to open device file
+   */
+  bool FeedbackQueue::open(std::string devfile_path) {
+    this->close();
+
+    // EV_FF の write には書き込み権限が必要
+    int fd = ::open(devfile_path.c_str(), O_RDWR | O_NONBLOCK);
+    if (fd < 0) {
+      return false;
+    }
+
+    this->attach(fd);
+    this->own_fd_ = true;
+    return true;
+  }
+
+  /**
+   * @brief use an already opened `fd` (e.g. uinput or test stand-in), not closed by `close()`
+   *
+   */
+  bool FeedbackQueue::attach(int fd) {
+    this->close();
+
+    if (fd < 0) {
+      return false;
+    }
+
+    this->fd_ = fd;
+    this->own_fd_ = false;
+    this->head_ = 0;
+    this->count_ = 0;
+    for (int i = 0; i < MAX_FF_EFFECTS; i++) {
+      this->effect_ids_[i] = -1;
+    }
+
+    this->running_ = true;
+    this->worker_ = std::thread(&FeedbackQueue::run, this);
+    return true;
+  }
+
+  /**
+   * @brief stop worker thread, erase uploaded effects and close device file
+   *
+   * pending commands are discarded
+   */
+  void FeedbackQueue::close() {
+    if (this->worker_.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->running_ = false;
+        this->count_ = 0;
+      }
+      this->cond_.notify_one();
+      this->worker_.join();
+    }
+
+    if (this->fd_ < 0) {
+      return;
+    }
+
+    for (int i = 0; i < MAX_FF_EFFECTS; i++) {
+      if (this->effect_ids_[i] >= 0) {
+        ioctl(this->fd_, EVIOCRMFF, this->effect_ids_[i]);
+        this->effect_ids_[i] = -1;
+      }
+    }
+
+    if (this->own_fd_) {
+      ::close(this->fd_);
+    }
+    this->fd_ = -1;
+    this->own_fd_ = false;
+  }
+
+  bool FeedbackQueue::supports(uint16_t ff_type) {
+    if (this->fd_ < 0) {
+      return false;
+    }
+
+    uint8_t bits[FF_CNT / 8 + 1];
+    memset(bits, 0, sizeof(bits));
+    if (ioctl(this->fd_, EVIOCGBIT(EV_FF, sizeof(bits)), bits) < 0) {
+      return false;
+    }
+
+    return (bits[ff_type / 8] >> (ff_type % 8)) & 1;
+  }
+
+  namespace {
+    // Upload 同士, Play/Stop 同士, Gain 同士は最新のもので上書き
+    bool supersedes(const FeedbackCommand& command, const FeedbackCommand& queued) {
+      bool is_playback = (command.type == FeedbackType::Play || command.type == FeedbackType::Stop);
+      bool queued_playback = (queued.type == FeedbackType::Play || queued.type == FeedbackType::Stop);
+
+      bool same_kind = (is_playback && queued_playback) || (queued.type == command.type);
+      bool same_slot = (command.type == FeedbackType::Gain) || (queued.slot == command.slot);
+      return same_kind && same_slot;
+    }
+  }
+
+  /**
+   * @brief enqueue `commands` all together, or none of them
+   *
+   * does not wait for the lock: if the worker holds it, the commands are dropped
+   * (the caller may be a realtime thread, waiting on the worker would invert priority)
+   *
+   * @retval `false`: not open, queue is full or busy (commands are dropped)
+   */
+  bool FeedbackQueue::push(const FeedbackCommand* commands, int num) {
+    for (int k = 0; k < num; k++) {
+      if (commands[k].slot >= MAX_FF_EFFECTS) {
+        return false;
+      }
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      this->dropped_.fetch_add(num, std::memory_order_relaxed);
+      return false;
+    }
+
+    if (!this->running_) {
+      return false;
+    }
+
+    // 上書きできないコマンドの分だけ空きが必要
+    int needed = 0;
+    for (int k = 0; k < num; k++) {
+      bool merged = false;
+      for (int i = 0; i < this->count_ && !merged; i++) {
+        merged = supersedes(commands[k], this->queue_[(this->head_ + i) % MAX_FF_COMMANDS]);
+      }
+      for (int j = 0; j < k && !merged; j++) {
+        merged = supersedes(commands[k], commands[j]);
+      }
+      if (!merged) {
+        needed++;
+      }
+    }
+
+    if (this->count_ + needed > MAX_FF_COMMANDS) {
+      this->dropped_.fetch_add(num, std::memory_order_relaxed);
+      return false;
+    }
+
+    for (int k = 0; k < num; k++) {
+      enqueue(commands[k]);
+    }
+    this->cond_.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief put `command` in the queue, replacing a queued command it supersedes (lock held, room checked)
+   *
+   */
+  void FeedbackQueue::enqueue(const FeedbackCommand& command) {
+    int superseded = -1;
+    bool followed = false;  // 上書き対象より後ろに同じ slot のコマンドがあるか
+
+    for (int i = 0; i < this->count_; i++) {
+      const FeedbackCommand& queued = this->queue_[(this->head_ + i) % MAX_FF_COMMANDS];
+
+      if (supersedes(command, queued)) {
+        superseded = i;
+        followed = false;
+      }
+      else if (superseded >= 0 && command.type != FeedbackType::Gain && queued.slot == command.slot) {
+        followed = true;
+      }
+    }
+
+    if (superseded >= 0) {
+      this->coalesced_.fetch_add(1, std::memory_order_relaxed);
+
+      if (!followed) {
+        this->queue_[(this->head_ + superseded) % MAX_FF_COMMANDS] = command;
+        return;
+      }
+
+      // 順序が入れ替わらないよう取り除いて末尾に積み直す
+      for (int i = superseded; i < this->count_ - 1; i++) {
+        this->queue_[(this->head_ + i) % MAX_FF_COMMANDS] =
+          this->queue_[(this->head_ + i + 1) % MAX_FF_COMMANDS];
+      }
+      this->queue_[(this->head_ + this->count_ - 1) % MAX_FF_COMMANDS] = command;
+      return;
+    }
+
+    this->queue_[(this->head_ + this->count_) % MAX_FF_COMMANDS] = command;
+    this->count_++;
+  }
+
+  bool FeedbackQueue::upload(uint8_t slot, const ff_effect& effect) {
+    FeedbackCommand command;
+    command.type = FeedbackType::Upload;
+    command.slot = slot;
+    command.value = 0;
+    command.effect = effect;
+    return push(&command, 1);
+  }
+
+  bool FeedbackQueue::play(uint8_t slot, int32_t count) {
+    FeedbackCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = FeedbackType::Play;
+    command.slot = slot;
+    command.value = count;
+    return push(&command, 1);
+  }
+
+  bool FeedbackQueue::stop(uint8_t slot) {
+    FeedbackCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = FeedbackType::Stop;
+    command.slot = slot;
+    return push(&command, 1);
+  }
+
+  bool FeedbackQueue::setGain(uint16_t gain) {
+    FeedbackCommand command;
+    memset(&command, 0, sizeof(command));
+    command.type = FeedbackType::Gain;
+    command.value = gain;
+    return push(&command, 1);
+  }
+
+  /**
+   * @brief upload `FF_RUMBLE` effect to `RUMBLE_SLOT` and play it once (both queued or neither)
+   *
+   * @param strong magnitude of strong (low frequency) motor: 0.0 ~ 1.0
+   * @param weak   magnitude of weak (high frequency) motor: 0.0 ~ 1.0
+   */
+  bool FeedbackQueue::rumble(float strong, float weak, uint16_t duration_ms) {
+    auto magnitude = [](float value) -> uint16_t {
+      if (value <= 0.0f) return 0;
+      if (value >= 1.0f) return 0xffff;
+      return static_cast<uint16_t>(value * 0xffff);
+    };
+
+    FeedbackCommand commands[2];
+    memset(commands, 0, sizeof(commands));
+
+    ff_effect& effect = commands[0].effect;
+    effect.type = FF_RUMBLE;
+    effect.id = -1;
+    effect.u.rumble.strong_magnitude = magnitude(strong);
+    effect.u.rumble.weak_magnitude = magnitude(weak);
+    effect.replay.length = duration_ms;
+
+    commands[0].type = FeedbackType::Upload;
+    commands[0].slot = RUMBLE_SLOT;
+    commands[1].type = FeedbackType::Play;
+    commands[1].slot = RUMBLE_SLOT;
+    commands[1].value = 1;
+
+    // 再生だけが捨てられて effect が書き換わったまま残らないよう，まとめて積む
+    return push(commands, 2);
+  }
+
+  void FeedbackQueue::execute(FeedbackCommand& command) {
+    input_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = EV_FF;
+
+    switch (command.type) {
+      case FeedbackType::Upload: {
+        // 同じ slot は同じ effect id を更新する
+        command.effect.id = this->effect_ids_[command.slot];
+        if (ioctl(this->fd_, EVIOCSFF, &command.effect) < 0) {
+          this->errors_.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        this->effect_ids_[command.slot] = command.effect.id;
+        return;
+      }
+      case FeedbackType::Play:
+      case FeedbackType::Stop: {
+        if (this->effect_ids_[command.slot] < 0) {
+          this->errors_.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        event.code = this->effect_ids_[command.slot];
+        event.value = (command.type == FeedbackType::Play) ? command.value : 0;
+        break;
+      }
+      case FeedbackType::Gain: {
+        event.code = FF_GAIN;
+        event.value = command.value;
+        break;
+      }
+    }
+
+    if (write(this->fd_, &event, sizeof(event)) != sizeof(event)) {
+      this->errors_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief worker thread: pop one command and execute it without holding the lock
+   *
+   */
+  void FeedbackQueue::run() {
+    while (true) {
+      FeedbackCommand command;
+      {
+        std::unique_lock<std::mutex> lock(this->mutex_);
+        this->cond_.wait(lock, [this] { return !this->running_ || this->count_ > 0; });
+
+        if (!this->running_) {
+          return;
+        }
+
+        command = this->queue_[this->head_];
+        this->head_ = (this->head_ + 1) % MAX_FF_COMMANDS;
+        this->count_--;
+      }
+
+      execute(command);
+    }
+  }
+}
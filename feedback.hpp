@@ -0,0 +1,105 @@
+#ifndef PAD_FEEDBACK_H
+#define PAD_FEEDBACK_H
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <linux/input.h>
+#include <sys/ioctl.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace pad {
+
+  constexpr int MAX_FF_COMMANDS = 16;  // 出力キューの長さ
+  constexpr int MAX_FF_EFFECTS  = 8;   // アプリ側で使う effect の slot 数
+  constexpr int RUMBLE_SLOT     = 0;   // rumble() で使う slot
+
+  enum class FeedbackType : uint8_t {
+    Upload,
+    Play,
+    Stop,
+    Gain
+  };
+
+  struct FeedbackCommand {
+    FeedbackType type;
+    uint8_t      slot;
+    int32_t      value;   // Play: 再生回数, Gain: 0 ~ 0xffff
+    ff_effect    effect;  // Upload のみ
+  };
+
+  /**
+   * @brief force feedback output queue, `EVIOCSFF` / `write()` run on a worker thread
+   *
+   * commands for the same slot are coalesced in the queue (latest upload / latest play or stop).
+   * the caller never waits for the worker: a command is dropped when the queue is full or busy.
+   */
+  class FeedbackQueue {
+   private:
+    int  fd_{-1};
+    bool own_fd_{false};
+    bool running_{false};
+
+    std::thread worker_;
+    std::mutex  mutex_;
+    std::condition_variable cond_;
+
+    FeedbackCommand queue_[MAX_FF_COMMANDS];
+    int head_{0};
+    int count_{0};
+
+    // slot -> カーネルが割り当てた effect id (worker スレッドのみが触る)
+    int16_t effect_ids_[MAX_FF_EFFECTS];
+
+    std::atomic<uint32_t> coalesced_{0};
+    std::atomic<uint32_t> dropped_{0};
+    std::atomic<uint32_t> errors_{0};
+
+    bool push(const FeedbackCommand* commands, int num);
+    void enqueue(const FeedbackCommand& command);
+    void execute(FeedbackCommand& command);
+    void run();
+
+   public:
+    FeedbackQueue();
+    ~FeedbackQueue();
+
+    bool open(std::string devfile_path);
+    bool attach(int fd);
+    void close();
+
+    bool isOpen() {
+      return this->fd_ >= 0;
+    }
+
+    bool supports(uint16_t ff_type);
+
+    bool upload(uint8_t slot, const ff_effect& effect);
+    bool play(uint8_t slot, int32_t count = 1);
+    bool stop(uint8_t slot);
+    bool setGain(uint16_t gain);
+    bool rumble(float strong, float weak, uint16_t duration_ms);
+
+    // 上書きで省略されたコマンド数
+    uint32_t getCoalescedCount() {
+      return this->coalesced_.load(std::memory_order_relaxed);
+    }
+
+    // キューが一杯 (または worker がロック中) で捨てたコマンド数
+    uint32_t getDroppedCount() {
+      return this->dropped_.load(std::memory_order_relaxed);
+    }
+
+    // ioctl / write に失敗したコマンド数
+    uint32_t getErrorCount() {
+      return this->errors_.load(std::memory_order_relaxed);
+    }
+  };
+}
+
+#endif // PAD_FEEDBACK_H
@@ -1,6 +1,12 @@
 #include "gamepad.hpp"
+#include "trace.hpp"
 #include <cstdio>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
 
 namespace pad {
   /**
@@ -42,6 +48,12 @@ namespace pad {
 
     is_readable = openDeviceFile(devfile_path);
 
+    // イベントのタイムスタンプを CLOCK_MONOTONIC に揃える (trace と比較するため)
+    if (is_readable) {
+      int clock_id = CLOCK_MONOTONIC;
+      ioctl(this->fd_, EVIOCSCLOCKID, &clock_id);
+    }
+
     connection_ = is_readable;
     event_ = {
       .type =  EventType::None,
@@ -56,23 +68,35 @@ namespace pad {
    * @brief read raw-event from device file
    * 
    * @retval true: read raw-event 
-   * @retval false: no raw-event or fail to read  
+   * @retval false: no raw-event, `EV_SYN` (`isSync()`) or fail to read  
    */
   bool PadReader::readEvent() {
+    sync_ = false;
+
     if (read(this->fd_, &(raw_event_), sizeof(raw_event_)) > 0) {
 
       if (raw_event_.type == EV_SYN) {
+        sync_ = true;
+        if (raw_event_.code == SYN_REPORT) {
+          sync_time_us_.store(static_cast<int64_t>(raw_event_.time.tv_sec) * 1000000
+                              + raw_event_.time.tv_usec, std::memory_order_relaxed);
+        }
         return false;
       }
 
       switch (raw_event_.type) {
         case EV_ABS: event_.type = EventType::Axis;   break;
         case EV_KEY: event_.type = EventType::Button; break;
+        default:     event_.type = EventType::None;   break;
       }
 
       event_.code  = raw_event_.code;
       event_.value = raw_event_.value; 
 
+      if (trace::isEnabled()) {
+        trace::beginEvent(raw_event_.time, raw_event_.code);
+      }
+
       return true;
     }
     else {
@@ -84,12 +108,68 @@ namespace pad {
     }   
   }
 
+  /**
+   * @brief apply cpu affinity and `SCHED_FIFO` priority of `config` to `thread`
+   * 
+   * @retval `false`: fail to apply (e.g. no `CAP_SYS_NICE`)
+   */
+  bool applyThreadConfig(pthread_t thread, const RealtimeConfig& config) {
+    bool result = true;
+
+    if (config.cpu >= 0) {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET(config.cpu, &cpuset);
+      if (pthread_setaffinity_np(thread, sizeof(cpuset), &cpuset) != 0)
+        result = false;
+    }
+
+    if (config.priority > 0) {
+      sched_param param;
+      param.sched_priority = config.priority;
+      if (pthread_setschedparam(thread, SCHED_FIFO, &param) != 0)
+        result = false;
+    }
+
+    return result;
+  }
+
+  /**
+   * @brief lock current and future pages of the process to avoid page faults
+   * 
+   */
+  bool lockMemory() {
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+  }
+
+  PadEventHandler::PadEventHandler() {
+    memset(this->code_table_, INVALID_ID, sizeof(this->code_table_));
+  }
+
+  /**
+   * @brief expand `id_map_` into `code_table_`, call after setting `id_map_`
+   * 
+   */
+  void PadEventHandler::buildCodeTable() {
+    memset(this->code_table_, INVALID_ID, sizeof(this->code_table_));
+
+    for (auto& entry: this->id_map_) {
+      if (entry.first < KEY_CNT) {
+        this->code_table_[entry.first] = entry.second;
+      }
+    }
+  }
+
   void PadEventHandler::setDeadZone(float deadzone) {
     this->deadzone_ = deadzone;
   }
 
   void PadEventHandler::handleEvent(PadReader& reader) {
-    this->event_ = reader.getPadEvent();
+    handleEvent(reader.getPadEvent());
+  }
+
+  void PadEventHandler::handleEvent(const PadEvent& event) {
+    this->event_ = event;
 
     switch (event_.type) {
       case (EventType::Button): {
@@ -103,6 +183,10 @@ namespace pad {
       default:
         break;
     }
+
+    if (trace::isEnabled()) {
+      trace::record(trace::Stage::Decode);
+    }
   }
 
 
@@ -112,57 +196,53 @@ namespace pad {
     InputData(total_input)
   {
     this->event_buffer_.resize(MAX_EVENTS);
+    memset(this->edges_, 0, sizeof(this->edges_));
     this->clearData();
   }
 
   void ButtonData::clearData() {
-    for (auto e: this->input_values_) {
-      e = false;
-    }
+    std::fill(this->input_values_.begin(), this->input_values_.end(), false);
   }
 
   bool ButtonData::pushed(uint8_t id) {
     if (id >= input_values_.size())
       return false;
 
-    if (event_count_ >= MAX_EVENTS)
-      return false;
-
     if (input_values_[id] == false) {
       return false;
     }
 
-    ButtonEvent event;
-    for (int i = 0; i < event_count_; i++) {
-      event = event_buffer_[i];
-      if (event.id == id && event.state == true) {
-        return true;
-      }
-    }
-
-    return false;
+    return edges_[id] & EDGE_PUSHED;
   }
 
   bool ButtonData::released(uint8_t id) {
     if (id >= input_values_.size())
       return false;
 
-    if (event_count_ >= MAX_EVENTS)
-      return false;
-
     if (input_values_[id] == true) {
       return false;
     }
 
-    ButtonEvent event;
-    for (int i = 0; i < event_count_; i++) {
-      event = event_buffer_[i];
-      if (event.id == id && event.state == false) {
-        return true;
-      }
-    }
+    return edges_[id] & EDGE_RELEASED;
+  }
+
+  /**
+   * @brief set state of button `id` and record it as a button event
+   * 
+   */
+  void ButtonData::setState(uint8_t id, bool state) {
+    if (id < input_values_.size()) 
+      input_values_[id] = state;
+    else 
+      return;
+
+    edges_[id] |= state ? EDGE_PUSHED : EDGE_RELEASED;
+    has_edges_ = true;
 
-    return false;
+    if (event_count_ < MAX_EVENTS)
+      event_buffer_[event_count_++] = {id, state};    
+    else 
+      return;
   }
 
   void ButtonData::update(PadEventHandler& handler) {
@@ -171,16 +251,32 @@ namespace pad {
     }
 
     ButtonEvent event = handler.getButtonEvent();
-    if (event.id < input_values_.size()) 
-      input_values_[event.id] = event.state;
-    else 
-      return;
+    setState(event.id, event.state);
 
-    if (event_count_ < MAX_EVENTS)
-      event_buffer_[event_count_++] = event;    
-    else 
-      return;
+    if (trace::isEnabled()) {
+      trace::record(trace::Stage::Update);
+    }
+  }
+
+  /**
+   * @brief copy states, edges and events of `src` (e.g. from another source of the same buttons)
+   *
+   */
+  void ButtonData::copyFrom(const ButtonData& src) {
+    size_t size = std::min(this->input_values_.size(), src.input_values_.size());
+    for (size_t i = 0; i < size; i++) {
+      this->input_values_[i] = src.input_values_[i];
+    }
+
+    if (this->has_edges_ || src.has_edges_) {
+      memcpy(this->edges_, src.edges_, sizeof(this->edges_));
+      this->has_edges_ = src.has_edges_;
+    }
 
+    this->event_count_ = src.event_count_;
+    for (int i = 0; i < src.event_count_; i++) {
+      this->event_buffer_[i] = src.event_buffer_[i];
+    }
   }
 
   AxisData::AxisData(uint total_input):
@@ -190,9 +286,12 @@ namespace pad {
   }
 
   void AxisData::clearData() {
-    for (auto e: this->input_values_) {
-      e = 0.0;
-    }
+    std::fill(this->input_values_.begin(), this->input_values_.end(), 0.0f);
+  }
+
+  void AxisData::setValue(uint8_t id, float value) {
+    if (id < input_values_.size())
+      input_values_[id] = value;
   }
 
   void AxisData::update(PadEventHandler& handler) {
@@ -201,7 +300,10 @@ namespace pad {
     }
 
     AxisEvent event = handler.getAxisEvent();
-    if (event.id <= input_values_.size())
-      input_values_[event.id] = event.value;
+    setValue(event.id, event.value);
+
+    if (trace::isEnabled()) {
+      trace::record(trace::Stage::Update);
+    }
   }
 }
\ No newline at end of file
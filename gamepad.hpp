@@ -6,6 +6,8 @@
 #include <stdint.h>
 #include <linux/input.h>
 #include <sys/ioctl.h>
+#include <poll.h>
+#include <pthread.h>
 
 #include <string>
 #include <memory>
@@ -14,6 +16,13 @@
 #include <unordered_map>
 #include <vector>
 #include <type_traits>
+#include <cstring>
+#include <atomic>
+#include <thread>
+
+#include "trace.hpp"
+#include "motion.hpp"
+#include "feedback.hpp"
 
 namespace pad {
 
@@ -21,6 +30,10 @@ namespace pad {
   constexpr int DEFAULT_BUTTON_NUM = 20;
   constexpr int DEFALUT_AXIS_NUM = 8;
   constexpr int MAX_EVENTS = 32;
+  constexpr int MAX_SOURCES = 4;
+  constexpr int MAX_QUEUED_EVENTS = 256;  // reader スレッド -> update() のキュー長 (2のべき乗)
+  constexpr uint8_t INVALID_ID = 0xff;
+  constexpr int READER_POLL_TIMEOUT_MS = 100;
 
   enum class EventType {
     None, 
@@ -43,7 +56,9 @@ namespace pad {
    private:
     std::string path;
 
-    bool connection_;
+    std::atomic<bool> connection_{false};
+    bool sync_{false};
+    std::atomic<int64_t> sync_time_us_{0};
     int  fd_{-1};
     input_event raw_event_;
     PadEvent    event_;
@@ -64,6 +79,89 @@ namespace pad {
     inline PadEvent getPadEvent() {
       return this->event_;
     }
+
+    inline int getFd() {
+      return this->fd_;
+    }
+
+    // 直前の readEvent() が EV_SYN で終わったか (続きのフレームがあり得る)
+    inline bool isSync() {
+      return this->sync_;
+    }
+
+    // 直近の SYN_REPORT のカーネルタイムスタンプ [us] (CLOCK_MONOTONIC)
+    inline int64_t getSyncTime() {
+      return this->sync_time_us_.load(std::memory_order_relaxed);
+    }
+  };
+
+
+  /**
+   * @brief single producer / single consumer queue of `PadEvent` (reader thread -> `update()`)
+   * 
+   */
+  class PadEventQueue {
+   private:
+    struct Entry {
+      PadEvent event;
+      uint64_t trace_seq;
+    };
+
+    Entry buffer_[MAX_QUEUED_EVENTS];
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+
+   public:
+    bool push(const PadEvent& event, uint64_t trace_seq) {
+      uint32_t tail = this->tail_.load(std::memory_order_relaxed);
+      if (tail - this->head_.load(std::memory_order_acquire) >= MAX_QUEUED_EVENTS) {
+        return false;
+      }
+
+      this->buffer_[tail % MAX_QUEUED_EVENTS] = {event, trace_seq};
+      this->tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool pop(PadEvent& event, uint64_t& trace_seq) {
+      uint32_t head = this->head_.load(std::memory_order_relaxed);
+      if (head == this->tail_.load(std::memory_order_acquire)) {
+        return false;
+      }
+
+      event = this->buffer_[head % MAX_QUEUED_EVENTS].event;
+      trace_seq = this->buffer_[head % MAX_QUEUED_EVENTS].trace_seq;
+      this->head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    void clear() {
+      this->head_.store(this->tail_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+  };
+
+
+  /**
+   * @brief real-time configuration of `BasePad`
+   * 
+   */
+  struct RealtimeConfig {
+    bool reader_thread{false};  // デバイスファイルを専用スレッドで読む
+    int  cpu{-1};               // reader スレッドの CPU affinity (-1: 指定しない)
+    int  priority{0};           // reader スレッドの SCHED_FIFO 優先度 (0: 変更しない)
+    bool lock_memory{false};    // mlockall(MCL_CURRENT | MCL_FUTURE)
+  };
+
+  bool applyThreadConfig(pthread_t thread, const RealtimeConfig& config);
+  bool lockMemory();
+
+  struct PadMetrics {
+    uint64_t updates;
+    uint64_t events;
+    uint64_t dropped_events;    // reader スレッドのキューが一杯で捨てたイベント (ボタンを離したイベントも捨てられ，押されたままになる)
+    int64_t  last_update_ns;
+    int64_t  max_update_ns;     // update() の最悪実行時間
+    uint64_t coalesced_events;  // axis coalescing で省略した軸イベント
   };
 
 
@@ -87,6 +185,7 @@ namespace pad {
   class PadEventHandler {
    protected:
     code_id_map id_map_;
+    uint8_t     code_table_[KEY_CNT];  // id_map_ を展開した CODE -> ID の表
     PadEvent    event_;
     ButtonEvent button_event_ = {.id = 0, .state = false};
     AxisEvent axis_event_ = {.id = 0, .value = 0.0f};
@@ -95,10 +194,49 @@ namespace pad {
     virtual void handleButtonEvent() = 0;
     virtual void handleAxisEvent() = 0;
 
+    void buildCodeTable();
+
+    // update 中に map へ挿入しないよう表を引く (未登録の CODE は INVALID_ID)
+    uint8_t lookupId(uint16_t code) {
+      if (code >= KEY_CNT) {
+        return INVALID_ID;
+      }
+      return this->code_table_[code];
+    }
+
    public:
+    PadEventHandler();
+    virtual ~PadEventHandler() = default;
+
     void handleEvent(PadReader& reader);
+    void handleEvent(const PadEvent& event);
     void setDeadZone(float deadzone);
 
+    /**
+     * @brief called after the device file is opened (e.g. query capabilities by `ioctl`)
+     * 
+     */
+    virtual void onConnect(int fd) {
+      (void)fd;
+    }
+
+    // ボタンの CODE -> ID (接続時に EVIOCGKEY で取得した状態の反映用，未登録は INVALID_ID)
+    virtual uint8_t buttonId(uint16_t code) {
+      return lookupId(code);
+    }
+
+    // ハットの値 -> 押されている十字キーの ID (0 または十字キーでない CODE は INVALID_ID)
+    virtual uint8_t hatButtonId(uint16_t code, int32_t value) {
+      (void)code;
+      (void)value;
+      return INVALID_ID;
+    }
+
+    // axis coalescing で最後の値だけを処理してよい CODE か (ハット -> 十字キーは除く)
+    virtual bool isCoalescable(uint16_t code) {
+      return code < ABS_HAT0X || code > ABS_HAT3Y;
+    }
+
     EventType getEventType() { 
       return this->event_.type; 
     }
@@ -131,6 +269,10 @@ namespace pad {
       return this->input_values_;
     }
 
+    const std::vector<T>& getData() {
+      return this->input_values_;
+    }
+
     int getSize() {
       return this->input_values_.size();
     }
@@ -148,15 +290,37 @@ namespace pad {
     uint8_t event_count_{0};
     std::vector<ButtonEvent> event_buffer_;
 
+    // 直近の update() で起きた変化 (ID ごと, MAX_EVENTS を超えても失われない)
+    static constexpr uint8_t EDGE_PUSHED   = 1 << 0;
+    static constexpr uint8_t EDGE_RELEASED = 1 << 1;
+    uint8_t edges_[std::numeric_limits<uint8_t>::max() + 1];
+    bool    has_edges_{false};
+
    public:
     ButtonData(uint total_input);
     void clearData() override;
     bool pushed(uint8_t id);
     bool released(uint8_t id);
+    void setState(uint8_t id, bool state);
+
+    // pushed() / released() を発生させずに状態だけを書き換える
+    void assignState(uint8_t id, bool state) {
+      if (id < input_values_.size()) {
+        input_values_[id] = state;
+      }
+    }
     void update(PadEventHandler& handler) override;
 
+    // `src` の状態と直近の update() でのボタンイベントを写す (ボタン数が同じこと)
+    void copyFrom(const ButtonData& src);
+
     void clearEvents() {
       event_count_ = 0;
+
+      if (has_edges_) {
+        memset(edges_, 0, sizeof(edges_));
+        has_edges_ = false;
+      }
     }
 
     int getEventCount() {
@@ -175,6 +339,7 @@ namespace pad {
    public:  
     AxisData(uint total_input);
     void clearData() override;
+    void setValue(uint8_t id, float value);
     void update(PadEventHandler& handler) override;
 
     float getValue(uint8_t id) {
@@ -186,6 +351,18 @@ namespace pad {
     }
   };  
 
+  /**
+   * @brief additional device file of the same controller, updated in `BasePad::update()`
+   * 
+   */
+  class InputSource {
+   public:
+    virtual ~InputSource() = default;
+    virtual bool isConnected() = 0;
+    virtual void clearData() = 0;
+    virtual void update() = 0;
+  };
+
   // テンプレートクラスが PadEventHandler を継承している制約
   template<typename Handler, 
     typename = std::enable_if_t<std::is_base_of<PadEventHandler, Handler>::value>>
@@ -195,9 +372,133 @@ namespace pad {
     PadReader   reader_;
     ButtonData  buttons_;
     AxisData    axes_;
+    MotionData  motion_;
+    FeedbackQueue feedback_;
+    InputSource* sources_[MAX_SOURCES];
+    int source_count_{0};
     bool is_connected_{false};
     std::string devfile_path_;
 
+    // trace 用: 直近の update() で反映したがまだ読み出されていないイベント範囲
+    uint64_t trace_first_seq_{0};
+    uint32_t trace_pending_{0};
+
+    // real-time 設定 (reader スレッド使用時は update() はキューから取り出すだけ)
+    RealtimeConfig rt_config_;
+    PadEventQueue  queue_;
+    std::thread    reader_thread_;
+    std::atomic<bool>     reader_running_{false};
+    std::atomic<uint64_t> dropped_events_{0};
+    PadMetrics metrics_ = {0, 0, 0, 0, 0, 0};
+
+    void readerLoop() {
+      pollfd pfd = {this->reader_.getFd(), POLLIN, 0};
+
+      while (this->reader_running_.load(std::memory_order_relaxed)) {
+        if (poll(&pfd, 1, READER_POLL_TIMEOUT_MS) <= 0) {
+          continue;
+        }
+
+        while (this->reader_.readEvent()) {
+          uint64_t seq = trace::isEnabled() ? trace::currentSeq() : 0;
+          // キューが一杯なら捨てる (ボタンを離したイベントも失われるため dropped_events で検出する)
+          if (!this->queue_.push(this->reader_.getPadEvent(), seq)) {
+            this->dropped_events_.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+
+        if (!this->reader_.isConnected()) {
+          break;
+        }
+      }
+
+      // スレッドを作り直すたびに trace のバッファが増えないよう返却する
+      trace::releaseThread();
+    }
+
+    bool startReaderThread() {
+      this->queue_.clear();
+      this->reader_running_ = true;
+      this->reader_thread_ = std::thread(&BasePad::readerLoop, this);
+      return applyThreadConfig(this->reader_thread_.native_handle(), this->rt_config_);
+    }
+
+    void stopReaderThread() {
+      if (!this->reader_thread_.joinable()) {
+        return;
+      }
+
+      this->reader_running_ = false;
+      this->reader_thread_.join();
+    }
+
+    // axis coalescing: drain 中は軸ごとに最後の値だけを保持する
+    bool coalesce_axes_{false};
+    uint64_t axis_dirty_{0};
+    int32_t  axis_values_[ABS_CNT];
+    uint64_t axis_seqs_[ABS_CNT];
+
+    void processEvent(const PadEvent& event, uint64_t seq) {
+      if (this->coalesce_axes_ && event.type == EventType::Axis
+          && event.code < ABS_CNT && this->handler_->isCoalescable(event.code)) {
+        uint64_t bit = 1ull << event.code;
+        if (this->axis_dirty_ & bit) {
+          this->metrics_.coalesced_events++;
+        }
+
+        this->axis_dirty_ |= bit;
+        this->axis_values_[event.code] = event.value;
+        this->axis_seqs_[event.code] = seq;
+        return;
+      }
+
+      if (seq != 0) {
+        trace::setCurrentSeq(seq);
+      }
+
+      this->handler_->handleEvent(event);
+      dispatchEvent();
+    }
+
+    void flushAxes() {
+      while (this->axis_dirty_ != 0) {
+        uint16_t code = __builtin_ctzll(this->axis_dirty_);
+        this->axis_dirty_ &= this->axis_dirty_ - 1;
+
+        if (this->axis_seqs_[code] != 0) {
+          trace::setCurrentSeq(this->axis_seqs_[code]);
+        }
+
+        PadEvent event = {EventType::Axis, code, this->axis_values_[code]};
+        this->handler_->handleEvent(event);
+        dispatchEvent();
+      }
+    }
+
+    void dispatchEvent() {
+      switch (this->handler_->getEventType()) {
+        case EventType::Button: {
+          this->buttons_.update(*(this->handler_));
+          break;
+        }
+        case EventType::Axis: {
+          this->axes_.update(*(this->handler_));
+          break;
+        }
+        default:
+          break; 
+      }
+    }
+
+    void traceConsume() {
+      if (this->trace_pending_ == 0 || !trace::isEnabled()) {
+        return;
+      }
+
+      trace::recordConsume(this->trace_first_seq_, this->trace_pending_);
+      this->trace_pending_ = 0;
+    }
+
    public:
     BasePad(std::string devfile_path, 
             int button_num = DEFAULT_BUTTON_NUM, 
@@ -208,23 +509,157 @@ namespace pad {
       this->devfile_path_ = devfile_path;
       this->handler_ = std::make_unique<Handler>();
       this->is_connected_ = this->reader_.connect(devfile_path);
+
+      if (this->is_connected_) {
+        this->handler_->onConnect(this->reader_.getFd());
+      }
     }
 
     ~BasePad() {
+      this->feedback_.close();
+      this->stopReaderThread();
       this->reader_.disconnect();
+      this->motion_.disconnect();
+    }
+
+    /**
+     * @brief open the device file again for writing force feedback (rumble)
+     * 
+     * @retval `false`: no write permission or fail to open
+     */
+    bool connectFeedback() {
+      return this->feedback_.open(this->devfile_path_);
+    }
+
+    /**
+     * @brief queue rumble, never blocks (`EVIOCSFF` / `write()` run on a worker thread)
+     * 
+     */
+    bool rumble(float strong, float weak, uint16_t duration_ms) {
+      return this->feedback_.rumble(strong, weak, duration_ms);
+    }
+
+    bool stopRumble() {
+      return this->feedback_.stop(RUMBLE_SLOT);
+    }
+
+    FeedbackQueue& feedback() {
+      return this->feedback_;
+    }
+
+    /**
+     * @brief open motion sensors device file of the same controller
+     * 
+     * @param devfile_path "Motion Sensors" / "IMU" device file ( /dev/input/eventX )
+     */
+    bool connectMotion(std::string devfile_path) {
+      return this->motion_.connect(devfile_path);
+    }
+
+    bool isMotionConnected() {
+      return this->motion_.isConnected();
+    }
+
+    void setMotionFilterGain(float beta) {
+      this->motion_.setFilterGain(beta);
+    }
+
+    /**
+     * @brief update `source` (e.g. `ps5::Touchpad`) in the same `update()` cycle
+     * 
+     * @retval `false`: already `MAX_SOURCES` sources are attached
+     */
+    bool attachSource(InputSource& source) {
+      if (this->source_count_ >= MAX_SOURCES) {
+        return false;
+      }
+
+      this->sources_[this->source_count_++] = &source;
+      return true;
     }
 
     bool isConnected() {
       return is_connected_;
     }
 
+    // イベントループへの登録用 (reader スレッド使用時は reader スレッドが読む)
+    int getFd() {
+      return this->reader_.getFd();
+    }
+
+    // 直近に読み込んだフレームのカーネルタイムスタンプ [us]
+    int64_t getSyncTime() {
+      return this->reader_.getSyncTime();
+    }
+
     bool reconnect() {
       if (this->is_connected_) {
         return false;
       }
 
+      this->stopReaderThread();
       this->reader_.disconnect();
-      return this->reader_.connect(this->devfile_path_);
+      if (!this->reader_.connect(this->devfile_path_)) {
+        return false;
+      }
+
+      this->handler_->onConnect(this->reader_.getFd());
+
+      if (this->rt_config_.reader_thread) {
+        this->startReaderThread();
+      }
+      return true;
+    }
+
+    /**
+     * @brief apply real-time configuration
+     * 
+     * with `reader_thread`, the device file is read on a dedicated thread (affinity / priority
+     * of `config`) and `update()` only drains a preallocated queue.
+     * `update()`, `press()` / `pushed()` / `released()` / `axisValue()` and the `getButtonVec()` /
+     * `getAxisVec()` overloads copying into a caller-owned vector do not allocate heap memory
+     * in any configuration (the overloads returning a new vector do).
+     * events read while the queue is full are dropped, including button releases (the button
+     * stays pressed until its next event), and counted in `PadMetrics::dropped_events`.
+     * 
+     * @retval `false`: fail to lock memory or to set affinity / priority
+     */
+    bool setRealtimeConfig(const RealtimeConfig& config) {
+      bool result = true;
+
+      this->stopReaderThread();
+      this->rt_config_ = config;
+
+      if (config.lock_memory && !lockMemory()) {
+        result = false;
+      }
+
+      if (config.reader_thread && this->reader_.isConnected()) {
+        result = this->startReaderThread() && result;
+      }
+
+      return result;
+    }
+
+    /**
+     * @brief collapse axis events to the last value per axis in each `update()`
+     * 
+     * button events (including d-pad) are still processed in order,
+     * and all pending frames are read in one `update()`
+     */
+    void setAxisCoalescing(bool enable) {
+      this->coalesce_axes_ = enable;
+    }
+
+    PadMetrics getMetrics() {
+      PadMetrics metrics = this->metrics_;
+      metrics.dropped_events = this->dropped_events_.load(std::memory_order_relaxed);
+      return metrics;
+    }
+
+    void resetMetrics() {
+      this->metrics_ = {0, 0, 0, 0, 0, 0};
+      this->dropped_events_ = 0;
     }
     
     void setDeadZone(float deadzone) {
@@ -237,57 +672,133 @@ namespace pad {
     }
 
     std::vector<bool> getButtonVec() {
+      traceConsume();
       return this->buttons_.getVector();
     }
 
     std::vector<float> getAxisVec() {
+      traceConsume();
       return this->axes_.getVector();
     }
 
+    // 確保済みの `buttons` にコピーする (容量が足りていればメモリ確保なし)
+    void getButtonVec(std::vector<bool>& buttons) {
+      traceConsume();
+      buttons = this->buttons_.getData();
+    }
+
+    void getAxisVec(std::vector<float>& axes) {
+      traceConsume();
+      axes = this->axes_.getData();
+    }
+
     void update() {
+      int64_t start_ns = trace::nowNs();
+
       if (!(this->reader_.isConnected())) {
         this->is_connected_ = false;
         this->buttons_.clearData();
         this->axes_.clearData();
+        this->motion_.clearData();
+        for (int i = 0; i < this->source_count_; i++) {
+          this->sources_[i]->clearData();
+        }
         return;
       }
 
-      this->buttons_.clearEvents();
+      this->motion_.update();
+      for (int i = 0; i < this->source_count_; i++) {
+        this->sources_[i]->update();
+      }
 
-      while (this->reader_.readEvent()) {
-        this->handler_->handleEvent(this->reader_);
-        EventType type = this->handler_->getEventType();
+      this->buttons_.clearEvents();
+      this->trace_pending_ = 0;
+      uint64_t num_events = 0;
+
+      // coalescing 中の軸イベントは flushAxes() まで処理を遅らせる
+      bool coalesce = this->coalesce_axes_;
+
+      if (this->reader_thread_.joinable()) {
+        PadEvent event;
+        uint64_t seq;
+
+        while (this->queue_.pop(event, seq)) {
+          if (trace::isEnabled() && seq != 0) {
+            if (this->trace_pending_ == 0) {
+              this->trace_first_seq_ = seq;
+            }
+            this->trace_pending_++;
+          }
+          else {
+            seq = 0;
+          }
 
-        switch (type) {
-          case EventType::Button: {
-            this->buttons_.update(*(this->handler_));
+          processEvent(event, seq);
+          num_events++;
+        }
+      }
+      else {
+        while (true) {
+          if (!this->reader_.readEvent()) {
+            // coalescing 時は溜まっているフレームを全て読み切る
+            if (coalesce && this->reader_.isSync()) {
+              continue;
+            }
             break;
           }
-          case EventType::Axis: {
-            this->axes_.update(*(this->handler_));
-            break;
+
+          uint64_t seq = 0;
+          if (trace::isEnabled()) {
+            seq = trace::currentSeq();
+            if (this->trace_pending_ == 0) {
+              this->trace_first_seq_ = seq;
+            }
+            this->trace_pending_++;
           }
-          default:
-            break; 
+
+          processEvent(this->reader_.getPadEvent(), seq);
+          num_events++;
         }
       }
+
+      this->flushAxes();
+
+      int64_t elapsed_ns = trace::nowNs() - start_ns;
+      this->metrics_.updates++;
+      this->metrics_.events += num_events;
+      this->metrics_.last_update_ns = elapsed_ns;
+      if (elapsed_ns > this->metrics_.max_update_ns) {
+        this->metrics_.max_update_ns = elapsed_ns;
+      }
     }
 
     bool press(uint8_t id) {
+      traceConsume();
       return this->buttons_.getState(id);
     }
 
     bool pushed(uint8_t id) {
+      traceConsume();
       return this->buttons_.pushed(id);
     }
 
     bool released(uint8_t id) {
+      traceConsume();
       return this->buttons_.released(id);
     }
 
     float axisValue(uint8_t id) {
+      traceConsume();
       return this->axes_.getValue(id);
     }
+
+    Quaternion orientation() {
+      return this->motion_.getQuaternion();
+    }
+
+    MotionSample motionSample() {
+      return this->motion_.getSample();
+    }
   };
 
   template <typename Handler,
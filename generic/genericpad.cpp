@@ -0,0 +1,382 @@
+#include "genericpad.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace pad {
+  namespace generic {
+    namespace {
+      struct MappingEntry {
+        bool     any_device;
+        uint16_t vendor;
+        uint16_t product;
+        bool     is_button;
+        uint16_t code;
+        uint8_t  id;
+        bool     invert;
+      };
+
+      // loadMapping() で起動時に一度だけ読み込む
+      std::vector<MappingEntry> mapping_entries;
+
+      struct CodeName {
+        const char* name;
+        uint16_t    code;
+      };
+
+      const CodeName code_names[] = {
+        {"BTN_SOUTH", BTN_SOUTH}, {"BTN_EAST", BTN_EAST}, {"BTN_C", BTN_C},
+        {"BTN_NORTH", BTN_NORTH}, {"BTN_WEST", BTN_WEST}, {"BTN_Z", BTN_Z},
+        {"BTN_TL", BTN_TL}, {"BTN_TR", BTN_TR}, {"BTN_TL2", BTN_TL2}, {"BTN_TR2", BTN_TR2},
+        {"BTN_SELECT", BTN_SELECT}, {"BTN_START", BTN_START}, {"BTN_MODE", BTN_MODE},
+        {"BTN_THUMBL", BTN_THUMBL}, {"BTN_THUMBR", BTN_THUMBR},
+        {"BTN_DPAD_UP", BTN_DPAD_UP}, {"BTN_DPAD_DOWN", BTN_DPAD_DOWN},
+        {"BTN_DPAD_LEFT", BTN_DPAD_LEFT}, {"BTN_DPAD_RIGHT", BTN_DPAD_RIGHT},
+        {"BTN_TRIGGER", BTN_TRIGGER}, {"BTN_THUMB", BTN_THUMB}, {"BTN_THUMB2", BTN_THUMB2},
+        {"BTN_TOP", BTN_TOP}, {"BTN_TOP2", BTN_TOP2}, {"BTN_PINKIE", BTN_PINKIE},
+        {"BTN_BASE", BTN_BASE}, {"BTN_BASE2", BTN_BASE2}, {"BTN_BASE3", BTN_BASE3},
+        {"BTN_BASE4", BTN_BASE4}, {"BTN_BASE5", BTN_BASE5}, {"BTN_BASE6", BTN_BASE6},
+        {"ABS_X", ABS_X}, {"ABS_Y", ABS_Y}, {"ABS_Z", ABS_Z},
+        {"ABS_RX", ABS_RX}, {"ABS_RY", ABS_RY}, {"ABS_RZ", ABS_RZ},
+        {"ABS_THROTTLE", ABS_THROTTLE}, {"ABS_RUDDER", ABS_RUDDER},
+        {"ABS_GAS", ABS_GAS}, {"ABS_BRAKE", ABS_BRAKE},
+        {"ABS_HAT0X", ABS_HAT0X}, {"ABS_HAT0Y", ABS_HAT0Y},
+      };
+
+      const uint16_t standard_button_codes[] = {
+        BTN_SOUTH,  BTN_EAST,  BTN_NORTH, BTN_WEST,
+        BTN_TL,     BTN_TR,    BTN_TL2,   BTN_TR2,
+        BTN_SELECT, BTN_START, BTN_MODE,
+        BTN_THUMBL, BTN_THUMBR,
+        BTN_DPAD_LEFT, BTN_DPAD_RIGHT, BTN_DPAD_UP, BTN_DPAD_DOWN,
+      };
+      const uint8_t standard_button_ids[] = {
+        ButtonID::south,  ButtonID::east,  ButtonID::north, ButtonID::west,
+        ButtonID::L1,     ButtonID::R1,    ButtonID::L2,    ButtonID::R2,
+        ButtonID::select, ButtonID::start, ButtonID::mode,
+        ButtonID::L3,     ButtonID::R3,
+        ButtonID::left,   ButtonID::right, ButtonID::up,    ButtonID::down,
+      };
+
+      bool parseCode(const std::string& text, uint16_t& code) {
+        for (auto& entry: code_names) {
+          if (text == entry.name) {
+            code = entry.code;
+            return true;
+          }
+        }
+
+        char* end;
+        long value = strtol(text.c_str(), &end, 0);
+        if (*end != '\0' || value < 0 || value >= KEY_CNT) {
+          return false;
+        }
+
+        code = value;
+        return true;
+      }
+
+      inline bool testBit(const uint8_t* bits, int n) {
+        return (bits[n / 8] >> (n % 8)) & 1;
+      }
+    }
+
+    bool loadMapping(std::string mapping_path, std::string* error) {
+      int line_number = 0;
+      auto fail = [&](const std::string& reason) {
+        if (error != nullptr) {
+          *error = mapping_path + ":" + std::to_string(line_number) + ": " + reason;
+        }
+        return false;
+      };
+
+      std::ifstream file(mapping_path);
+      if (!file) {
+        if (error != nullptr) {
+          *error = mapping_path + ": cannot open file";
+        }
+        return false;
+      }
+
+      std::vector<MappingEntry> entries;
+      MappingEntry current = {true, 0, 0, false, 0, INVALID_ID, false};
+      std::string line;
+
+      while (std::getline(file, line)) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string kind, code_text, option;
+
+        if (!(words >> kind)) {
+          continue;
+        }
+
+        if (kind == "device") {
+          unsigned int vendor, product;
+          if (!(words >> code_text) || sscanf(code_text.c_str(), "%x:%x", &vendor, &product) != 2) {
+            return fail("expected device <vendor>:<product>");
+          }
+          current.any_device = false;
+          current.vendor = vendor;
+          current.product = product;
+          continue;
+        }
+
+        if (kind != "button" && kind != "axis") {
+          return fail("unknown entry '" + kind + "'");
+        }
+
+        int id;
+        if (!(words >> code_text >> id)) {
+          return fail("expected " + kind + " <code> <id>");
+        }
+
+        MappingEntry entry = current;
+        entry.is_button = (kind == "button");
+        entry.invert = (words >> option) && option == "invert";
+        if (!parseCode(code_text, entry.code)) {
+          return fail("unknown code '" + code_text + "'");
+        }
+
+        // ID は ButtonData / AxisData の範囲内のみ
+        int num_ids = entry.is_button ? dev::num_buttons : dev::num_axes;
+        if (id < 0 || id >= num_ids) {
+          return fail(kind + " id " + std::to_string(id)
+                      + " out of range (0 ~ " + std::to_string(num_ids - 1) + ")");
+        }
+        if (!entry.is_button && entry.code >= ABS_CNT) {
+          return fail("axis code " + std::to_string(entry.code) + " out of range");
+        }
+        entry.id = static_cast<uint8_t>(id);
+
+        entries.push_back(entry);
+      }
+
+      mapping_entries = entries;
+      return true;
+    }
+
+
+    /* [ GenericHandler member functions ] */
+
+    GenericHandler::GenericHandler() {
+      memset(this->button_ids_, INVALID_ID, sizeof(this->button_ids_));
+      for (auto& param: this->axis_params_) {
+        param = {INVALID_ID, 0.0f, 0.0f, 0.0f};
+      }
+      memset(this->hat_values_, 0, sizeof(this->hat_values_));
+
+      this->deadzone_ = default_deadzone;
+    }
+
+    /**
+     * @brief build dense code -> ID tables and axis normalisation from device capabilities
+     *
+     */
+    void GenericHandler::onConnect(int fd) {
+      memset(this->button_ids_, INVALID_ID, sizeof(this->button_ids_));
+      for (auto& param: this->axis_params_) {
+        param = {INVALID_ID, 0.0f, 0.0f, 0.0f};
+      }
+      memset(this->hat_values_, 0, sizeof(this->hat_values_));
+
+      uint8_t key_bits[KEY_CNT / 8 + 1];
+      uint8_t abs_bits[ABS_CNT / 8 + 1];
+      memset(key_bits, 0, sizeof(key_bits));
+      memset(abs_bits, 0, sizeof(abs_bits));
+      ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits);
+      ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs_bits)), abs_bits);
+
+      input_id device_id;
+      memset(&device_id, 0, sizeof(device_id));
+      ioctl(fd, EVIOCGID, &device_id);
+
+      // ボタン: 標準の CODE は固定 ID, 残りは CODE 順
+      for (size_t i = 0; i < sizeof(standard_button_ids); i++) {
+        if (testBit(key_bits, standard_button_codes[i])) {
+          this->button_ids_[standard_button_codes[i]] = standard_button_ids[i];
+        }
+      }
+
+      uint8_t next_id = ButtonID::other;
+      for (int code = BTN_MISC; code < KEY_CNT && next_id < dev::num_buttons; code++) {
+        if (testBit(key_bits, code) && this->button_ids_[code] == INVALID_ID) {
+          this->button_ids_[code] = next_id++;
+        }
+      }
+
+      // 軸: 右スティックが ABS_Z / ABS_RZ にある (ABS_RX / ABS_RY がない) パッドに対応
+      bool has_rx = testBit(abs_bits, ABS_RX) || testBit(abs_bits, ABS_RY);
+      uint8_t axis_ids[ABS_CNT];
+      memset(axis_ids, INVALID_ID, sizeof(axis_ids));
+
+      axis_ids[ABS_X]  = AxisID::leftX;
+      axis_ids[ABS_Y]  = AxisID::leftY;
+      axis_ids[ABS_Z]  = has_rx ? AxisID::L2depth : AxisID::rightX;
+      axis_ids[ABS_RZ] = has_rx ? AxisID::R2depth : AxisID::rightY;
+      axis_ids[ABS_RX] = AxisID::rightX;
+      axis_ids[ABS_RY] = AxisID::rightY;
+      if (!testBit(abs_bits, ABS_Z) || !has_rx) {
+        axis_ids[ABS_BRAKE] = AxisID::L2depth;
+        axis_ids[ABS_GAS]   = AxisID::R2depth;
+      }
+
+      next_id = AxisID::other;
+      for (int code = 0; code < ABS_CNT; code++) {
+        if (!testBit(abs_bits, code)) {
+          continue;
+        }
+
+        // ハットは十字キー, マルチタッチなどは対象外
+        if ((code >= ABS_HAT0X && code <= ABS_HAT3Y) || code >= ABS_MISC) {
+          continue;
+        }
+
+        uint8_t id = axis_ids[code];
+        if (id == INVALID_ID) {
+          if (next_id >= dev::num_axes) continue;
+          id = next_id++;
+        }
+
+        axis_ids[code] = id;
+      }
+
+      auto setAxis = [&](uint16_t code, uint8_t id, bool invert) -> bool {
+        input_absinfo absinfo;
+        if (ioctl(fd, EVIOCGABS(code), &absinfo) < 0 || absinfo.maximum <= absinfo.minimum) {
+          return false;
+        }
+
+        float range = static_cast<float>(absinfo.maximum - absinfo.minimum);
+        AxisParam& param = this->axis_params_[code];
+        param.id = id;
+
+        if (id == AxisID::L2depth || id == AxisID::R2depth) {
+          // トリガー: 0.0 <--> 1.0
+          param.scale  = 1.0f / range;
+          param.offset = -absinfo.minimum / range;
+          param.flat   = absinfo.flat / range;
+        }
+        else {
+          // スティック: -1.0 <--> 1.0 (Y軸は上側が+)
+          param.scale  = 2.0f / range;
+          param.offset = -2.0f * absinfo.minimum / range - 1.0f;
+          param.flat   = 2.0f * absinfo.flat / range;
+
+          if (id == AxisID::leftY || id == AxisID::rightY) {
+            invert = !invert;
+          }
+        }
+
+        if (invert) {
+          param.scale  = -param.scale;
+          param.offset = -param.offset;
+        }
+        return true;
+      };
+
+      for (int code = 0; code < ABS_CNT; code++) {
+        if (testBit(abs_bits, code) && axis_ids[code] != INVALID_ID
+            && !(code >= ABS_HAT0X && code <= ABS_HAT3Y) && code < ABS_MISC) {
+          setAxis(code, axis_ids[code], false);
+        }
+      }
+
+      // マッピングファイルによる上書き
+      for (auto& entry: mapping_entries) {
+        if (!entry.any_device
+            && (entry.vendor != device_id.vendor || entry.product != device_id.product)) {
+          continue;
+        }
+
+        // 同じ ID を持っていた CODE は割り当てを外す (1 つの ID に複数の入力を重ねない)
+        if (entry.is_button) {
+          for (int code = 0; code < KEY_CNT; code++) {
+            if (this->button_ids_[code] == entry.id) {
+              this->button_ids_[code] = INVALID_ID;
+            }
+          }
+          this->button_ids_[entry.code] = entry.id;
+        }
+        else if (setAxis(entry.code, entry.id, entry.invert)) {
+          for (int code = 0; code < ABS_CNT; code++) {
+            if (code != entry.code && this->axis_params_[code].id == entry.id) {
+              this->axis_params_[code].id = INVALID_ID;
+            }
+          }
+        }
+      }
+    }
+
+    void GenericHandler::handleHatData(uint16_t code, int32_t val) {
+      int32_t& pre_val = this->hat_values_[code - ABS_HAT0X];
+      bool is_x = (code == ABS_HAT0X);
+
+      uint8_t negative = is_x ? ButtonID::left  : ButtonID::up;
+      uint8_t positive = is_x ? ButtonID::right : ButtonID::down;
+
+      event_.type = EventType::Button;
+      if (val > 0) {
+        button_event_ = {positive, true};
+      }
+      else if (val < 0) {
+        button_event_ = {negative, true};
+      }
+      else {
+        button_event_ = {(pre_val > 0) ? positive : negative, false};
+      }
+
+      pre_val = val;
+    }
+
+    uint8_t GenericHandler::buttonId(uint16_t code) {
+      return (code < KEY_CNT) ? this->button_ids_[code] : INVALID_ID;
+    }
+
+    uint8_t GenericHandler::hatButtonId(uint16_t code, int32_t value) {
+      if (value == 0) {
+        return INVALID_ID;
+      }
+
+      switch (code) {
+        case ABS_HAT0X: return (value > 0) ? ButtonID::right : ButtonID::left;
+        case ABS_HAT0Y: return (value > 0) ? ButtonID::down  : ButtonID::up;
+        default:        return INVALID_ID;
+      }
+    }
+
+    void GenericHandler::handleAxisEvent() {
+      uint16_t code = event_.code;
+
+      if (code == ABS_HAT0X || code == ABS_HAT0Y) {
+        handleHatData(code, event_.value);
+        return;
+      }
+
+      if (code >= ABS_CNT || this->axis_params_[code].id == INVALID_ID) {
+        event_.type = EventType::None;
+        return;
+      }
+
+      const AxisParam& param = this->axis_params_[code];
+      float fval = event_.value * param.scale + param.offset;
+      if (fabs(fval) < deadzone_ || fabs(fval) < param.flat) fval = 0.0;
+
+      axis_event_.id = param.id;
+      axis_event_.value = fval;
+    }
+
+    void GenericHandler::handleButtonEvent() {
+      if (event_.code >= KEY_CNT || this->button_ids_[event_.code] == INVALID_ID) {
+        event_.type = EventType::None;
+        return;
+      }
+
+      button_event_.id = this->button_ids_[event_.code];
+      button_event_.state = (event_.value != 0);
+    }
+  }
+}
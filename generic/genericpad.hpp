@@ -0,0 +1,95 @@
+#ifndef GENERIC_PAD_H
+#define GENERIC_PAD_H
+
+#include "gamepad.hpp"
+
+namespace pad {
+
+  namespace generic {
+
+    namespace dev {
+      constexpr uint8_t num_buttons = 32;
+      constexpr uint8_t num_axes = 12;
+    }
+
+    const float default_deadzone = 0.05;
+
+    // 標準的なゲームパッドの CODE は固定の ID (GamePad<ps5::PS5Handler> と同じ並び)
+    // それ以外のボタン・軸は CODE 順に other 以降の ID を割り当てる
+    namespace ButtonID {
+      constexpr uint8_t south  = 0;
+      constexpr uint8_t east   = 1;
+      constexpr uint8_t north  = 2;
+      constexpr uint8_t west   = 3;
+      constexpr uint8_t L1     = 4;
+      constexpr uint8_t R1     = 5;
+      constexpr uint8_t L2     = 6;
+      constexpr uint8_t R2     = 7;
+      constexpr uint8_t select = 8;
+      constexpr uint8_t start  = 9;
+      constexpr uint8_t mode   = 10;
+      constexpr uint8_t L3     = 11;
+      constexpr uint8_t R3     = 12;
+      constexpr uint8_t left   = 13;
+      constexpr uint8_t right  = 14;
+      constexpr uint8_t up     = 15;
+      constexpr uint8_t down   = 16;
+      constexpr uint8_t other  = 17;
+    }
+
+    namespace AxisID {
+      constexpr uint8_t leftX   = 0;
+      constexpr uint8_t leftY   = 1;
+      constexpr uint8_t L2depth = 2;
+      constexpr uint8_t rightX  = 3;
+      constexpr uint8_t rightY  = 4;
+      constexpr uint8_t R2depth = 5;
+      constexpr uint8_t other   = 6;
+    }
+
+    /**
+     * @brief load mapping file once at startup, used by every `GenericHandler` on connect
+     *
+     * format (one entry per line, `#` comment):
+     *   device <vendor>:<product>      following entries apply only to this device (hex)
+     *   button <code> <id>             <code>: number or name (BTN_SOUTH, ...)
+     *   axis   <code> <id> [invert]    <code>: number or name (ABS_X, ...)
+     * an entry takes its ID away from the code that had it before.
+     *
+     * @param error set to "<path>:<line>: <reason>" when parsing fails (optional)
+     * @retval `false`: fail to open or parse the file (the previous mapping is kept)
+     */
+    bool loadMapping(std::string mapping_path, std::string* error = nullptr);
+
+    /**
+     * @brief handler for arbitrary evdev gamepads built from `EVIOCGBIT` / `EVIOCGABS`
+     *
+     */
+    class GenericHandler: public PadEventHandler {
+     private:
+      // 軸の正規化: value * scale + offset (-1.0 <--> 1.0 または 0.0 <--> 1.0)
+      struct AxisParam {
+        uint8_t id;
+        float   scale;
+        float   offset;
+        float   flat;   // absinfo の flat を正規化した値
+      };
+
+      uint8_t   button_ids_[KEY_CNT];
+      AxisParam axis_params_[ABS_CNT];
+      int32_t   hat_values_[ABS_HAT3Y - ABS_HAT0X + 1];
+
+      void handleHatData(uint16_t code, int32_t val);
+      void handleButtonEvent() override;
+      void handleAxisEvent() override;
+
+     public:
+      GenericHandler();
+      void onConnect(int fd) override;
+      uint8_t buttonId(uint16_t code) override;
+      uint8_t hatButtonId(uint16_t code, int32_t value) override;
+    };
+  }
+}
+
+#endif // GENERIC_PAD_H
@@ -0,0 +1,283 @@
+#include "motion.hpp"
+
+#include <cerrno>
+#include <cmath>
+
+namespace pad {
+
+  namespace {
+    constexpr float deg_to_rad = static_cast<float>(M_PI / 180.0);
+
+    // 異常なタイムスタンプ差分 (再接続など) は積分しない
+    constexpr uint32_t max_sample_interval_us = 100000;
+
+    inline float invSqrt(float x) {
+      return 1.0f / std::sqrt(x);
+    }
+  }
+
+  /* [ MotionReader member functions ] */
+
+  MotionReader::~MotionReader() { disconnect(); }
+
+  /**
+   * @brief open device file of motion sensors ( /dev/eventX ) and load calibration
+   *
+   * @retval `true`: succeed in opening device file
+   * @retval `false`: fail to open device file
+   */
+  bool MotionReader::connect(std::string devfile_path) {
+    // read only, non blocking mode
+    this->fd_ = open(devfile_path.c_str(), O_RDONLY | O_NONBLOCK);
+    this->connection_ = (this->fd_ >= 0);
+    this->sample_count_ = 0;
+    this->timestamp_us_ = 0;
+    this->dropped_ = false;
+
+    if (this->connection_) {
+      loadCalibration();
+    }
+
+    return this->connection_;
+  }
+
+  void MotionReader::disconnect() {
+    if (this->fd_ >= 0) {
+      close(this->fd_);
+      this->fd_ = -1;
+    }
+    this->connection_ = false;
+  }
+
+  /**
+   * @brief get resolution of each axis by `EVIOCGABS`
+   *
+   * accel: units per G, gyro: units per deg/s (hid-playstation / hid-nintendo)
+   */
+  void MotionReader::loadCalibration() {
+    for (int i = 0; i < 6; i++) {
+      input_absinfo absinfo;
+      this->raw_[i] = 0;
+      this->scale_[i] = 0.0f;
+
+      if (ioctl(this->fd_, EVIOCGABS(ABS_X + i), &absinfo) < 0) {
+        continue;
+      }
+
+      this->raw_[i] = absinfo.value;
+      if (absinfo.resolution > 0) {
+        this->scale_[i] = 1.0f / absinfo.resolution;
+      }
+    }
+
+    // gyro は rad/s で扱う
+    for (int i = 3; i < 6; i++) {
+      this->scale_[i] *= deg_to_rad;
+    }
+  }
+
+  /**
+   * @brief read current values of ABS_X ~ ABS_RZ by `EVIOCGABS` (after `SYN_DROPPED`)
+   *
+   */
+  void MotionReader::syncAxes() {
+    for (int i = 0; i < 6; i++) {
+      input_absinfo absinfo;
+      if (ioctl(this->fd_, EVIOCGABS(ABS_X + i), &absinfo) == 0) {
+        this->raw_[i] = absinfo.value;
+      }
+    }
+  }
+
+  /**
+   * @brief read pending events at once and convert each `SYN_REPORT` frame to a sample
+   *
+   * @return number of samples in `getSamples()` (0: no event or fail to read)
+   */
+  int MotionReader::readSamples() {
+    this->sample_count_ = 0;
+
+    ssize_t size = read(this->fd_, this->events_, sizeof(this->events_));
+    if (size <= 0) {
+      // 再読込エラーでなければ，ノンブロッキングread以外のエラーなので接続終了
+      if (errno != EAGAIN)
+        this->connection_ = false;
+
+      return 0;
+    }
+
+    int num_events = size / sizeof(input_event);
+    for (int i = 0; i < num_events; i++) {
+      const input_event& event = this->events_[i];
+
+      // SYN_DROPPED から次の SYN_REPORT までのイベントは不完全なので捨てる
+      if (this->dropped_ && event.type != EV_SYN) {
+        continue;
+      }
+
+      switch (event.type) {
+        case EV_ABS: {
+          if (event.code <= ABS_RZ) {
+            this->raw_[event.code] = event.value;
+          }
+          break;
+        }
+        case EV_MSC: {
+          if (event.code == MSC_TIMESTAMP) {
+            this->timestamp_us_ = event.value;
+          }
+          break;
+        }
+        case EV_SYN: {
+          if (event.code == SYN_DROPPED) {
+            this->dropped_ = true;
+            break;
+          }
+          if (event.code != SYN_REPORT) {
+            break;
+          }
+
+          // SYN_DROPPED 後は次の SYN_REPORT で値を取り直す
+          bool resync = this->dropped_;
+          if (resync) {
+            this->dropped_ = false;
+            this->syncAxes();
+          }
+
+          MotionSample& sample = this->samples_[this->sample_count_++];
+          sample.accel = {
+            this->raw_[0] * this->scale_[0],
+            this->raw_[1] * this->scale_[1],
+            this->raw_[2] * this->scale_[2]
+          };
+          sample.gyro = {
+            this->raw_[3] * this->scale_[3],
+            this->raw_[4] * this->scale_[4],
+            this->raw_[5] * this->scale_[5]
+          };
+          sample.timestamp_us = this->timestamp_us_;
+          sample.resync = resync;
+          break;
+        }
+        default:
+          break;
+      }
+    }
+
+    return this->sample_count_;
+  }
+
+
+  /* [ MadgwickFilter member functions ] */
+
+  void MadgwickFilter::update(const Vector3& accel, const Vector3& gyro, float dt) {
+    float q0 = q_.w, q1 = q_.x, q2 = q_.y, q3 = q_.z;
+
+    // ジャイロによる姿勢変化率
+    float dq0 = 0.5f * (-q1 * gyro.x - q2 * gyro.y - q3 * gyro.z);
+    float dq1 = 0.5f * ( q0 * gyro.x + q2 * gyro.z - q3 * gyro.y);
+    float dq2 = 0.5f * ( q0 * gyro.y - q1 * gyro.z + q3 * gyro.x);
+    float dq3 = 0.5f * ( q0 * gyro.z + q1 * gyro.y - q2 * gyro.x);
+
+    float norm = accel.x * accel.x + accel.y * accel.y + accel.z * accel.z;
+
+    // 加速度が有効なときのみ重力方向で補正
+    if (norm > 0.0f) {
+      float r = invSqrt(norm);
+      float ax = accel.x * r, ay = accel.y * r, az = accel.z * r;
+
+      float _2q0 = 2.0f * q0, _2q1 = 2.0f * q1, _2q2 = 2.0f * q2, _2q3 = 2.0f * q3;
+      float _4q0 = 4.0f * q0, _4q1 = 4.0f * q1, _4q2 = 4.0f * q2;
+      float _8q1 = 8.0f * q1, _8q2 = 8.0f * q2;
+      float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+
+      // 目的関数の勾配
+      float s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+      float s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1
+               + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+      float s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2
+               + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+      float s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+
+      float s_norm = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+      if (s_norm > 0.0f) {
+        r = invSqrt(s_norm);
+        dq0 -= beta_ * s0 * r;
+        dq1 -= beta_ * s1 * r;
+        dq2 -= beta_ * s2 * r;
+        dq3 -= beta_ * s3 * r;
+      }
+    }
+
+    q0 += dq0 * dt;
+    q1 += dq1 * dt;
+    q2 += dq2 * dt;
+    q3 += dq3 * dt;
+
+    float r = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    q_ = {q0 * r, q1 * r, q2 * r, q3 * r};
+  }
+
+
+  /* [ MotionData member functions ] */
+
+  MotionData::MotionData() {
+    this->clearData();
+  }
+
+  bool MotionData::connect(std::string devfile_path) {
+    this->reader_.disconnect();
+    this->clearData();
+    return this->reader_.connect(devfile_path);
+  }
+
+  void MotionData::disconnect() {
+    this->reader_.disconnect();
+  }
+
+  void MotionData::clearData() {
+    this->latest_ = {{0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, 0, false};
+    this->has_timestamp_ = false;
+    this->sample_count_ = 0;
+    this->filter_.reset();
+  }
+
+  /**
+   * @brief read all pending samples and run the filter over each batch
+   *
+   */
+  void MotionData::update() {
+    this->sample_count_ = 0;
+
+    if (!(this->reader_.isConnected())) {
+      return;
+    }
+
+    int count;
+    while ((count = this->reader_.readSamples()) > 0) {
+      const MotionSample* samples = this->reader_.getSamples();
+
+      for (int i = 0; i < count; i++) {
+        const MotionSample& sample = samples[i];
+
+        // 取りこぼした区間の時刻はわからないので，フィルタは更新せず次のサンプルから測り直す
+        if (sample.resync) {
+          this->latest_ = sample;
+          this->has_timestamp_ = false;
+          continue;
+        }
+
+        // uint32_t の差分なのでタイムスタンプの折り返しも扱える
+        uint32_t interval = sample.timestamp_us - this->latest_.timestamp_us;
+        if (this->has_timestamp_ && interval > 0 && interval < max_sample_interval_us) {
+          this->filter_.update(sample.accel, sample.gyro, interval * 1e-6f);
+        }
+
+        this->latest_ = sample;
+        this->has_timestamp_ = true;
+      }
+
+      this->sample_count_ += count;
+    }
+  }
+}
@@ -0,0 +1,146 @@
+#ifndef PAD_MOTION_H
+#define PAD_MOTION_H
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <linux/input.h>
+#include <sys/ioctl.h>
+
+#include <string>
+
+namespace pad {
+
+  constexpr int   MAX_MOTION_EVENTS = 256;      // 1 回の read で読むイベント数
+  constexpr float DEFAULT_FILTER_GAIN = 0.1f;   // Madgwick filter の beta
+
+  struct Vector3 {
+    float x;
+    float y;
+    float z;
+  };
+
+  struct Quaternion {
+    float w;
+    float x;
+    float y;
+    float z;
+  };
+
+  struct MotionSample {
+    Vector3  accel;         // [G]
+    Vector3  gyro;          // [rad/s]
+    uint32_t timestamp_us;  // MSC_TIMESTAMP (デバイス側の時刻)
+    bool     resync;        // SYN_DROPPED 後に ioctl で取り直した値 (時刻は不明なので積分しない)
+  };
+
+
+  /**
+   * @brief read accelerometer / gyroscope events of "Motion Sensors" / "IMU" device file
+   *
+   */
+  class MotionReader {
+   private:
+    bool connection_{false};
+    int  fd_{-1};
+    bool dropped_{false};
+
+    // ABS_X ~ ABS_RZ の生の値と単位変換の係数 (1 / resolution)
+    int32_t raw_[6];
+    float   scale_[6];
+    uint32_t timestamp_us_{0};
+
+    input_event  events_[MAX_MOTION_EVENTS];
+    MotionSample samples_[MAX_MOTION_EVENTS];
+    int sample_count_{0};
+
+    void loadCalibration();
+    void syncAxes();
+
+   public:
+    ~MotionReader();
+
+    bool connect(std::string devfile_path);
+    void disconnect();
+    int  readSamples();
+
+    inline bool isConnected() {
+      return this->connection_;
+    }
+
+    inline const MotionSample* getSamples() {
+      return this->samples_;
+    }
+  };
+
+
+  /**
+   * @brief orientation filter for accelerometer and gyroscope (Madgwick, IMU version)
+   *
+   */
+  class MadgwickFilter {
+   private:
+    float beta_{DEFAULT_FILTER_GAIN};
+    Quaternion q_ = {1.0f, 0.0f, 0.0f, 0.0f};
+
+   public:
+    void update(const Vector3& accel, const Vector3& gyro, float dt);
+
+    void reset() {
+      this->q_ = {1.0f, 0.0f, 0.0f, 0.0f};
+    }
+
+    void setGain(float beta) {
+      this->beta_ = beta;
+    }
+
+    Quaternion getQuaternion() {
+      return this->q_;
+    }
+  };
+
+
+  /**
+   * @brief latest motion sample and orientation, updated in batches per read
+   *
+   */
+  class MotionData {
+   private:
+    MotionReader   reader_;
+    MadgwickFilter filter_;
+    MotionSample   latest_;
+    bool has_timestamp_{false};
+    uint32_t sample_count_{0};
+
+   public:
+    MotionData();
+
+    bool connect(std::string devfile_path);
+    void disconnect();
+    void clearData();
+    void update();
+
+    bool isConnected() {
+      return this->reader_.isConnected();
+    }
+
+    void setFilterGain(float beta) {
+      this->filter_.setGain(beta);
+    }
+
+    Quaternion getQuaternion() {
+      return this->filter_.getQuaternion();
+    }
+
+    MotionSample getSample() {
+      return this->latest_;
+    }
+
+    // 直近の update() で処理したサンプル数
+    uint32_t getSampleCount() {
+      return this->sample_count_;
+    }
+  };
+}
+
+#endif // PAD_MOTION_H
@@ -38,6 +38,7 @@ namespace pad {
 
       this->axis_max_ = std::numeric_limits<int16_t>::max();
       this->deadzone_ = default_deadzone;
+      this->buildCodeTable();
     }
 
     void ProControllerHandler::handleCrossXData(int32_t val) {
@@ -88,9 +89,26 @@ namespace pad {
       }
     }
 
+    uint8_t ProControllerHandler::hatButtonId(uint16_t code, int32_t value) {
+      if (value == 0) {
+        return INVALID_ID;
+      }
+
+      switch (code) {
+        case ABS_HAT0X: return (value > 0) ? ButtonID::right : ButtonID::left;
+        case ABS_HAT0Y: return (value > 0) ? ButtonID::down  : ButtonID::up;
+        default:        return INVALID_ID;
+      }
+    }
+
     void ProControllerHandler::handleAxisEvent() {
       int32_t val = event_.value;
-      uint8_t id  = id_map_[event_.code]; 
+      uint8_t id  = lookupId(event_.code); 
+
+      if (id == INVALID_ID) {
+        event_.type = EventType::None;
+        return;
+      }
 
       switch (id) {
         case (internal_axis_crossX): {
@@ -120,7 +138,14 @@ namespace pad {
     }
 
     void ProControllerHandler::handleButtonEvent() {
-      button_event_.id = id_map_[event_.code];
+      uint8_t id = lookupId(event_.code);
+
+      if (id == INVALID_ID) {
+        event_.type = EventType::None;
+        return;
+      }
+
+      button_event_.id = id;
 
       switch (event_.value) {
         case 0: {
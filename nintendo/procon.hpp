@@ -9,6 +9,8 @@ namespace pad {
     
     const std::string evdev_procon_usb = "/dev/evdev_procon_usb";
     const std::string evdev_procon_bt  = "/dev/evdev_procon_bt";    
+    const std::string evdev_procon_imu_usb = "/dev/evdev_procon_imu_usb";
+    const std::string evdev_procon_imu_bt  = "/dev/evdev_procon_imu_bt";
     
     namespace dev {
       const int button_num = 18;
@@ -58,6 +60,7 @@ namespace pad {
 
       public:
       ProControllerHandler();
+      uint8_t hatButtonId(uint16_t code, int32_t value) override;
     };
   }
 }
@@ -0,0 +1,241 @@
+#include "ps5hidraw.hpp"
+
+namespace pad {
+  namespace ps5 {
+    namespace {
+      // レポート内のバイト位置 (axis は AxisID 順)
+      struct ReportLayout {
+        uint8_t axis[dev::num_axes];
+        uint8_t buttons[3];
+      };
+
+      constexpr ReportLayout usb_layout       = {{1, 2, 5, 3, 4, 6}, {8, 9, 10}};
+      constexpr ReportLayout bt_layout        = {{2, 3, 6, 4, 5, 7}, {9, 10, 11}};
+      constexpr ReportLayout bt_simple_layout = {{1, 2, 8, 3, 4, 9}, {5, 6, 7}};
+
+      // buttons[0] の上位4bit: square, cross, circle, triangle
+      constexpr uint8_t face_ids[4] = {
+        ButtonID::square, ButtonID::cross, ButtonID::circle, ButtonID::triangle
+      };
+
+      // buttons[1]: L1, R1, L2, R2, create, option, L3, R3
+      constexpr uint8_t shoulder_ids[8] = {
+        ButtonID::L1, ButtonID::R1, ButtonID::L2, ButtonID::R2,
+        ButtonID::create, ButtonID::option, ButtonID::L3, ButtonID::R3
+      };
+
+      constexpr uint32_t bit(uint8_t id) {
+        return 1u << id;
+      }
+
+      // buttons[0] の下位4bit (hat: 0 = 上から時計回り, 8 = ニュートラル) -> 十字キー
+      constexpr uint32_t hat_table[16] = {
+        bit(ButtonID::up),
+        bit(ButtonID::up)   | bit(ButtonID::right),
+        bit(ButtonID::right),
+        bit(ButtonID::right) | bit(ButtonID::down),
+        bit(ButtonID::down),
+        bit(ButtonID::down) | bit(ButtonID::left),
+        bit(ButtonID::left),
+        bit(ButtonID::left) | bit(ButtonID::up),
+        0, 0, 0, 0, 0, 0, 0, 0
+      };
+    }
+
+    bool parseHidReport(const uint8_t* report, size_t size, HidState& state) {
+      const ReportLayout* layout;
+
+      if (size == 0) {
+        return false;
+      }
+
+      if (report[0] == hid::usb_report_id && size >= hid::usb_report_size) {
+        layout = &usb_layout;
+      }
+      else if (report[0] == hid::bt_report_id && size >= hid::bt_report_size) {
+        layout = &bt_layout;
+      }
+      else if (report[0] == hid::usb_report_id && size >= hid::bt_simple_report_size) {
+        layout = &bt_simple_layout;
+      }
+      else {
+        return false;
+      }
+
+      for (int i = 0; i < dev::num_axes; i++) {
+        state.axes[i] = report[layout->axis[i]];
+      }
+
+      uint8_t b0 = report[layout->buttons[0]];
+      uint8_t b1 = report[layout->buttons[1]];
+      uint8_t b2 = report[layout->buttons[2]];
+
+      uint32_t buttons = hat_table[b0 & 0x0f];
+      for (int i = 0; i < 4; i++) {
+        buttons |= static_cast<uint32_t>((b0 >> (i + 4)) & 1) << face_ids[i];
+      }
+      for (int i = 0; i < 8; i++) {
+        buttons |= static_cast<uint32_t>((b1 >> i) & 1) << shoulder_ids[i];
+      }
+      buttons |= static_cast<uint32_t>(b2 & 1) << ButtonID::ps;
+
+      state.buttons = buttons;
+      return true;
+    }
+
+
+    /* [ HidrawReader member functions ] */
+
+    HidrawReader::~HidrawReader() { disconnect(); }
+
+    bool HidrawReader::connect(std::string devfile_path) {
+      // read only, non blocking mode
+      this->fd_ = open(devfile_path.c_str(), O_RDONLY | O_NONBLOCK);
+      this->connection_ = (this->fd_ >= 0);
+      this->report_size_ = 0;
+      return this->connection_;
+    }
+
+    void HidrawReader::disconnect() {
+      if (this->fd_ >= 0) {
+        close(this->fd_);
+        this->fd_ = -1;
+      }
+    }
+
+    /**
+     * @brief read one input report (hidraw returns one report per read)
+     *
+     * @retval true: read a report
+     * @retval false: no report or fail to read
+     */
+    bool HidrawReader::readReport() {
+      this->report_size_ = read(this->fd_, this->report_, sizeof(this->report_));
+
+      if (this->report_size_ > 0) {
+        return true;
+      }
+      else {
+        // 再読込エラーでなければ，ノンブロッキングread以外のエラーなので接続終了
+        if (errno != EAGAIN)
+          connection_ = false;
+
+        this->report_size_ = 0;
+        return false;
+      }
+    }
+
+
+    /* [ HidrawPad member functions ] */
+
+    HidrawPad::HidrawPad(std::string devfile_path):
+      buttons_(dev::num_buttons),
+      axes_(dev::num_axes),
+      state_()
+    {
+      this->devfile_path_ = devfile_path;
+      this->buildTables(default_deadzone);
+
+      // AxisID ごとに使う変換テーブル
+      this->axis_tables_[AxisID::leftX]   = this->stick_table_;
+      this->axis_tables_[AxisID::leftY]   = this->stick_inv_table_;
+      this->axis_tables_[AxisID::L2depth] = this->trigger_table_;
+      this->axis_tables_[AxisID::rightX]  = this->stick_table_;
+      this->axis_tables_[AxisID::rightY]  = this->stick_inv_table_;
+      this->axis_tables_[AxisID::R2depth] = this->trigger_table_;
+
+      // スティックの中立値で初期化
+      for (int i = 0; i < dev::num_axes; i++) {
+        this->state_.axes[i] = 0x80;
+      }
+      this->state_.axes[AxisID::L2depth] = 0;
+      this->state_.axes[AxisID::R2depth] = 0;
+
+      this->is_connected_ = this->reader_.connect(devfile_path);
+    }
+
+    HidrawPad::~HidrawPad() {
+      this->reader_.disconnect();
+    }
+
+    bool HidrawPad::reconnect() {
+      if (this->is_connected_) {
+        return false;
+      }
+
+      this->reader_.disconnect();
+      this->is_connected_ = this->reader_.connect(this->devfile_path_);
+      return this->is_connected_;
+    }
+
+    void HidrawPad::buildTables(float deadzone) {
+      const float axis_max = std::numeric_limits<uint8_t>::max();
+
+      for (int raw = 0; raw < 256; raw++) {
+        // PS5Handler と同じ正規化 (-1.0 <--> 1.0, Y軸は上側が+)
+        float stick = static_cast<float>(raw * 2 - axis_max) / axis_max;
+        float trigger = static_cast<float>(raw) / axis_max;
+
+        if (fabs(stick) < deadzone) stick = 0.0;
+        if (fabs(trigger) < deadzone) trigger = 0.0;
+
+        this->stick_table_[raw] = stick;
+        this->stick_inv_table_[raw] = -stick;
+        this->trigger_table_[raw] = trigger;
+      }
+    }
+
+    void HidrawPad::setDeadZone(float deadzone) {
+      this->buildTables(deadzone);
+
+      for (int i = 0; i < dev::num_axes; i++) {
+        this->axes_.setValue(i, axis_tables_[i][this->state_.axes[i]]);
+      }
+    }
+
+    void HidrawPad::applyReport(const uint8_t* report, size_t size) {
+      HidState next;
+      if (!parseHidReport(report, size, next)) {
+        return;
+      }
+
+      // 変化したボタンのみイベントとして反映
+      uint32_t changed = next.buttons ^ this->state_.buttons;
+      while (changed != 0) {
+        uint8_t id = __builtin_ctz(changed);
+        this->buttons_.setState(id, (next.buttons >> id) & 1);
+        changed &= changed - 1;
+      }
+
+      for (int i = 0; i < dev::num_axes; i++) {
+        this->axes_.setValue(i, axis_tables_[i][next.axes[i]]);
+      }
+
+      this->state_ = next;
+    }
+
+    void HidrawPad::update() {
+      if (!(this->reader_.isConnected())) {
+        this->is_connected_ = false;
+        this->buttons_.clearData();
+        this->axes_.clearData();
+        return;
+      }
+
+      this->buttons_.clearEvents();
+
+      while (this->reader_.readReport()) {
+        applyReport(this->reader_.getReport(), this->reader_.getReportSize());
+      }
+    }
+
+    /**
+     * @brief apply one recorded report as a single update cycle (for captures without device)
+     *
+     */
+    void HidrawPad::updateFromReport(const uint8_t* report, size_t size) {
+      this->buttons_.clearEvents();
+      applyReport(report, size);
+    }
+  }
+}
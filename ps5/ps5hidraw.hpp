@@ -0,0 +1,130 @@
+#ifndef PS5_HIDRAW_H
+#define PS5_HIDRAW_H
+
+#include "ps5pad.hpp"
+
+namespace pad {
+
+  namespace ps5 {
+    const std::string hidraw_symlink_usb = "/dev/hidraw_dualsense_usb";
+    const std::string hidraw_symlink_bt  = "/dev/hidraw_dualsense_bt";
+
+    namespace hid {
+      constexpr uint8_t usb_report_id = 0x01;  // USB 入力レポート / BT 簡易レポート
+      constexpr uint8_t bt_report_id  = 0x31;  // BT 拡張入力レポート
+
+      constexpr size_t usb_report_size       = 64;
+      constexpr size_t bt_report_size        = 78;
+      constexpr size_t bt_simple_report_size = 10;
+      constexpr size_t max_report_size       = 128;
+    }
+
+    // 1 レポート分のデコード結果
+    struct HidState {
+      uint32_t buttons;                 // bit n が ButtonID n の状態
+      uint8_t  axes[dev::num_axes];     // AxisID 順の生の値 (0 ~ 255)
+    };
+
+    /**
+     * @brief decode DualSense input report (USB / Bluetooth layout) into `state`
+     *
+     * @retval `true`: `report` is a known input report
+     * @retval `false`: unknown report id or size
+     */
+    bool parseHidReport(const uint8_t* report, size_t size, HidState& state);
+
+    /**
+     * @brief read raw HID input report of DualSense ( /dev/hidrawX )
+     *
+     */
+    class HidrawReader {
+     private:
+      bool    connection_{false};
+      int     fd_{-1};
+      ssize_t report_size_{0};
+      uint8_t report_[hid::max_report_size];
+
+     public:
+      ~HidrawReader();
+
+      bool connect(std::string devfile_path);
+      void disconnect();
+      bool readReport();
+
+      inline bool isConnected() {
+        return this->connection_;
+      }
+
+      inline const uint8_t* getReport() {
+        return this->report_;
+      }
+
+      inline size_t getReportSize() {
+        return this->report_size_;
+      }
+    };
+
+    /**
+     * @brief DualSense pad decoding whole hidraw reports, same ButtonID / AxisID as `GamePad<PS5Handler>`
+     *
+     */
+    class HidrawPad {
+     private:
+      HidrawReader reader_;
+      ButtonData   buttons_;
+      AxisData     axes_;
+      HidState     state_;
+      bool is_connected_{false};
+      std::string devfile_path_;
+
+      // 生の値 -> 正規化済みの値 の変換テーブル (deadzone 込み)
+      float stick_table_[256];
+      float stick_inv_table_[256];
+      float trigger_table_[256];
+      const float* axis_tables_[dev::num_axes];
+
+      void buildTables(float deadzone);
+      void applyReport(const uint8_t* report, size_t size);
+
+     public:
+      HidrawPad(std::string devfile_path);
+      ~HidrawPad();
+
+      bool isConnected() {
+        return is_connected_;
+      }
+
+      bool reconnect();
+      void setDeadZone(float deadzone);
+
+      std::vector<bool> getButtonVec() {
+        return this->buttons_.getVector();
+      }
+
+      std::vector<float> getAxisVec() {
+        return this->axes_.getVector();
+      }
+
+      void update();
+      void updateFromReport(const uint8_t* report, size_t size);
+
+      bool press(uint8_t id) {
+        return this->buttons_.getState(id);
+      }
+
+      bool pushed(uint8_t id) {
+        return this->buttons_.pushed(id);
+      }
+
+      bool released(uint8_t id) {
+        return this->buttons_.released(id);
+      }
+
+      float axisValue(uint8_t id) {
+        return this->axes_.getValue(id);
+      }
+    };
+  }
+}
+
+#endif // PS5_HIDRAW_H
@@ -37,6 +37,7 @@ namespace pad {
 
       this->axis_max_ = std::numeric_limits<uint8_t>::max();
       this->deadzone_ = default_deadzone;
+      this->buildCodeTable();
     }
 
     void PS5Handler::handleCrossXData(int32_t val) {
@@ -87,9 +88,26 @@ namespace pad {
       }
     }
 
+    uint8_t PS5Handler::hatButtonId(uint16_t code, int32_t value) {
+      if (value == 0) {
+        return INVALID_ID;
+      }
+
+      switch (code) {
+        case ABS_HAT0X: return (value > 0) ? ButtonID::right : ButtonID::left;
+        case ABS_HAT0Y: return (value > 0) ? ButtonID::down  : ButtonID::up;
+        default:        return INVALID_ID;
+      }
+    }
+
     void PS5Handler::handleAxisEvent() {
       int32_t val = event_.value;
-      uint8_t id  = id_map_[event_.code]; 
+      uint8_t id  = lookupId(event_.code); 
+
+      if (id == INVALID_ID) {
+        event_.type = EventType::None;
+        return;
+      }
 
       switch (id) {
         case (internal_axis_crossX): {
@@ -127,7 +145,14 @@ namespace pad {
     }
 
     void PS5Handler::handleButtonEvent() {
-      button_event_.id = id_map_[event_.code];
+      uint8_t id = lookupId(event_.code);
+
+      if (id == INVALID_ID) {
+        event_.type = EventType::None;
+        return;
+      }
+
+      button_event_.id = id;
       button_event_.state = (event_.value == 1) ? true : false;
     }
   }
@@ -8,6 +8,8 @@ namespace pad {
   namespace ps5 {
     const std::string evdev_symlink_usb = "/dev/evdev_dualsense_usb";
     const std::string evdev_symlink_bt  = "/dev/evdev_dualsense_bt";
+    const std::string evdev_symlink_motion_usb = "/dev/evdev_dualsense_motion_usb";
+    const std::string evdev_symlink_motion_bt  = "/dev/evdev_dualsense_motion_bt";
 
     namespace dev {
       constexpr uint8_t num_buttons = 17;
@@ -58,6 +60,7 @@ namespace pad {
 
      public:
       PS5Handler();
+      uint8_t hatButtonId(uint16_t code, int32_t value) override;
     };
   }
 }
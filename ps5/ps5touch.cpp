@@ -0,0 +1,209 @@
+#include "ps5touch.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+namespace pad {
+  namespace ps5 {
+
+    Touchpad::~Touchpad() { disconnect(); }
+
+    /**
+     * @brief open touchpad device file and load slot count / coordinate range by `EVIOCGABS`
+     *
+     * @retval `true`: succeed in opening device file
+     * @retval `false`: fail to open device file
+     */
+    bool Touchpad::connect(std::string devfile_path) {
+      this->disconnect();
+
+      // read only, non blocking mode
+      this->fd_ = open(devfile_path.c_str(), O_RDONLY | O_NONBLOCK);
+      this->connection_ = (this->fd_ >= 0);
+      this->slot_count_ = 0;
+
+      if (!this->connection_) {
+        return false;
+      }
+
+      input_absinfo absinfo;
+      if (ioctl(this->fd_, EVIOCGABS(ABS_MT_SLOT), &absinfo) == 0) {
+        this->slot_count_ = std::min(absinfo.maximum + 1, touch::max_slots);
+      }
+
+      if (ioctl(this->fd_, EVIOCGABS(ABS_MT_POSITION_X), &absinfo) == 0
+          && absinfo.maximum > absinfo.minimum) {
+        this->x_min_ = absinfo.minimum;
+        this->x_scale_ = 1.0f / (absinfo.maximum - absinfo.minimum);
+      }
+
+      if (ioctl(this->fd_, EVIOCGABS(ABS_MT_POSITION_Y), &absinfo) == 0
+          && absinfo.maximum > absinfo.minimum) {
+        this->y_min_ = absinfo.minimum;
+        this->y_scale_ = 1.0f / (absinfo.maximum - absinfo.minimum);
+      }
+
+      this->clearData();
+      this->syncSlots();
+      this->applyFrame();
+      this->down_mask_ = 0;
+      this->up_mask_ = 0;
+
+      return true;
+    }
+
+    void Touchpad::disconnect() {
+      if (this->fd_ >= 0) {
+        close(this->fd_);
+        this->fd_ = -1;
+      }
+      this->connection_ = false;
+    }
+
+    void Touchpad::clearData() {
+      for (int i = 0; i < touch::max_slots; i++) {
+        this->pending_[i] = {-1, 0, 0};
+        this->contacts_[i] = {false, -1, 0.0f, 0.0f};
+      }
+
+      this->down_mask_ = 0;
+      this->up_mask_ = 0;
+      this->click_.clearData();
+      this->click_.clearEvents();
+    }
+
+    int Touchpad::getActiveCount() {
+      int count = 0;
+      for (int i = 0; i < this->slot_count_; i++) {
+        if (this->contacts_[i].active) count++;
+      }
+      return count;
+    }
+
+    /**
+     * @brief read current slot values by `EVIOCGMTSLOTS` (after connect or `SYN_DROPPED`)
+     *
+     */
+    void Touchpad::syncSlots() {
+      struct {
+        uint32_t code;
+        int32_t  values[touch::max_slots];
+      } request;
+
+      input_absinfo absinfo;
+      if (ioctl(this->fd_, EVIOCGABS(ABS_MT_SLOT), &absinfo) == 0) {
+        this->current_slot_ = absinfo.value;
+      }
+
+      const uint32_t codes[3] = {ABS_MT_TRACKING_ID, ABS_MT_POSITION_X, ABS_MT_POSITION_Y};
+      for (int c = 0; c < 3; c++) {
+        request.code = codes[c];
+        if (ioctl(this->fd_, EVIOCGMTSLOTS(sizeof(request)), &request) < 0) {
+          return;
+        }
+
+        for (int i = 0; i < this->slot_count_; i++) {
+          switch (codes[c]) {
+            case ABS_MT_TRACKING_ID: pending_[i].tracking_id = request.values[i]; break;
+            case ABS_MT_POSITION_X:  pending_[i].x = request.values[i]; break;
+            case ABS_MT_POSITION_Y:  pending_[i].y = request.values[i]; break;
+          }
+        }
+      }
+    }
+
+    /**
+     * @brief apply pending slot values of one `SYN_REPORT` frame and detect touch-down / up
+     *
+     */
+    void Touchpad::applyFrame() {
+      for (int i = 0; i < this->slot_count_; i++) {
+        const SlotState& slot = this->pending_[i];
+        TouchContact& contact = this->contacts_[i];
+        bool active = (slot.tracking_id >= 0);
+
+        // tracking id が変わった場合は離れて別の指が触れたとみなす
+        if (contact.active && (!active || contact.tracking_id != slot.tracking_id)) {
+          this->up_mask_ |= (1u << i);
+        }
+        if (active && (!contact.active || contact.tracking_id != slot.tracking_id)) {
+          this->down_mask_ |= (1u << i);
+        }
+
+        contact.active = active;
+        contact.tracking_id = slot.tracking_id;
+        contact.x = (slot.x - this->x_min_) * this->x_scale_;
+        contact.y = (slot.y - this->y_min_) * this->y_scale_;
+      }
+    }
+
+    void Touchpad::update() {
+      this->down_mask_ = 0;
+      this->up_mask_ = 0;
+      this->click_.clearEvents();
+
+      if (!this->connection_) {
+        return;
+      }
+
+      ssize_t size;
+      while ((size = read(this->fd_, this->events_, sizeof(this->events_))) > 0) {
+        int num_events = size / sizeof(input_event);
+
+        for (int i = 0; i < num_events; i++) {
+          const input_event& event = this->events_[i];
+
+          if (event.type == EV_SYN) {
+            if (event.code == SYN_DROPPED) {
+              this->dropped_ = true;
+            }
+            else if (event.code == SYN_REPORT) {
+              // SYN_DROPPED 後は次の SYN_REPORT で状態を取り直す
+              if (this->dropped_) {
+                this->dropped_ = false;
+                this->syncSlots();
+              }
+              this->applyFrame();
+            }
+            continue;
+          }
+
+          if (this->dropped_) {
+            continue;
+          }
+
+          if (event.type == EV_KEY && event.code == BTN_LEFT) {
+            this->click_.setState(0, event.value != 0);
+            continue;
+          }
+
+          if (event.type != EV_ABS) {
+            continue;
+          }
+
+          if (event.code == ABS_MT_SLOT) {
+            this->current_slot_ = event.value;
+            continue;
+          }
+
+          if (this->current_slot_ < 0 || this->current_slot_ >= this->slot_count_) {
+            continue;
+          }
+
+          SlotState& slot = this->pending_[this->current_slot_];
+          switch (event.code) {
+            case ABS_MT_TRACKING_ID: slot.tracking_id = event.value; break;
+            case ABS_MT_POSITION_X:  slot.x = event.value; break;
+            case ABS_MT_POSITION_Y:  slot.y = event.value; break;
+            default: break;
+          }
+        }
+      }
+
+      // 再読込エラーでなければ，ノンブロッキングread以外のエラーなので接続終了
+      if (size < 0 && errno != EAGAIN) {
+        this->connection_ = false;
+      }
+    }
+  }
+}
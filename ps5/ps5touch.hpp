@@ -0,0 +1,112 @@
+#ifndef PS5_TOUCH_H
+#define PS5_TOUCH_H
+
+#include "ps5pad.hpp"
+
+namespace pad {
+
+  namespace ps5 {
+    const std::string evdev_symlink_touchpad_usb = "/dev/evdev_dualsense_touchpad_usb";
+    const std::string evdev_symlink_touchpad_bt  = "/dev/evdev_dualsense_touchpad_bt";
+
+    namespace touch {
+      constexpr int max_slots  = 8;   // DualSense は 2
+      constexpr int max_events = 64;  // 1 回の read で読むイベント数
+    }
+
+    struct TouchContact {
+      bool    active;
+      int32_t tracking_id;
+      float   x;  // 0.0 (左) <--> 1.0 (右)
+      float   y;  // 0.0 (上) <--> 1.0 (下)
+    };
+
+    /**
+     * @brief multitouch slots of DualSense touchpad device file, applied per `SYN_REPORT`
+     *
+     */
+    class Touchpad: public InputSource {
+     private:
+      // SYN_REPORT までに届いた各 slot の値
+      struct SlotState {
+        int32_t tracking_id;
+        int32_t x;
+        int32_t y;
+      };
+
+      bool connection_{false};
+      int  fd_{-1};
+      int  slot_count_{0};
+      int  current_slot_{0};
+      bool dropped_{false};
+
+      int32_t x_min_{0};
+      int32_t y_min_{0};
+      float   x_scale_{0.0f};
+      float   y_scale_{0.0f};
+
+      SlotState    pending_[touch::max_slots];
+      TouchContact contacts_[touch::max_slots];
+      input_event  events_[touch::max_events];
+
+      // 直近の update() での touch-down / touch-up (bit n が slot n)
+      uint32_t down_mask_{0};
+      uint32_t up_mask_{0};
+
+      // タッチパッドの押し込み (ID 0 のみ, pushed() / released() はボタンと同じ規則)
+      ButtonData click_{1};
+
+      void applyFrame();
+      void syncSlots();
+
+     public:
+      ~Touchpad();
+
+      bool connect(std::string devfile_path);
+      void disconnect();
+
+      bool isConnected() override {
+        return this->connection_;
+      }
+
+      void clearData() override;
+      void update() override;
+
+      int getSlotCount() {
+        return this->slot_count_;
+      }
+
+      TouchContact getContact(int slot) {
+        if (slot < 0 || slot >= this->slot_count_) {
+          return {false, -1, 0.0f, 0.0f};
+        }
+        return this->contacts_[slot];
+      }
+
+      int getActiveCount();
+
+      bool touchDown(int slot) {
+        return (slot >= 0 && slot < this->slot_count_) && ((this->down_mask_ >> slot) & 1);
+      }
+
+      bool touchUp(int slot) {
+        return (slot >= 0 && slot < this->slot_count_) && ((this->up_mask_ >> slot) & 1);
+      }
+
+      // タッチパッドの押し込み
+      bool pressClick() {
+        return this->click_.getState(0);
+      }
+
+      bool pushedClick() {
+        return this->click_.pushed(0);
+      }
+
+      bool releasedClick() {
+        return this->click_.released(0);
+      }
+    };
+  }
+}
+
+#endif // PS5_TOUCH_H
@@ -0,0 +1,435 @@
+#include "stream.hpp"
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace pad {
+
+  namespace stream {
+
+    // パケットはリトルエンディアン
+    static void put16(uint8_t* p, uint16_t v) {
+      p[0] = v; p[1] = v >> 8;
+    }
+
+    static void put32(uint8_t* p, uint32_t v) {
+      put16(p, v); put16(p + 2, v >> 16);
+    }
+
+    static void put64(uint8_t* p, uint64_t v) {
+      put32(p, v); put32(p + 4, v >> 32);
+    }
+
+    static uint16_t get16(const uint8_t* p) {
+      return p[0] | (p[1] << 8);
+    }
+
+    static uint32_t get32(const uint8_t* p) {
+      return get16(p) | (static_cast<uint32_t>(get16(p + 2)) << 16);
+    }
+
+    static uint64_t get64(const uint8_t* p) {
+      return get32(p) | (static_cast<uint64_t>(get32(p + 4)) << 32);
+    }
+
+    static int16_t quantize(float value) {
+      if (value >= 1.0f)  return 32767;
+      if (value <= -1.0f) return -32767;
+      return static_cast<int16_t>(lroundf(value * 32767.0f));
+    }
+
+    static float dequantize(int16_t value) {
+      return value / 32767.0f;
+    }
+
+    /*
+     * header
+     *   0: magic (uint16)   2: version   3: flags
+     *   4: sequence (uint32)
+     *   8: kernel timestamp [us] (int64)
+     *  16: number of buttons (uint16)   18: number of axes   19: reserved
+     *  20: session (uint32)
+     */
+    static void writeHeader(uint8_t* p, uint8_t flags, uint32_t session, uint32_t seq,
+                            int64_t timestamp_us, uint16_t button_num, uint8_t axis_num) {
+      put16(p, MAGIC);
+      p[2] = VERSION;
+      p[3] = flags;
+      put32(p + 4, seq);
+      put64(p + 8, timestamp_us);
+      put16(p + 16, button_num);
+      p[18] = axis_num;
+      p[19] = 0;
+      put32(p + 20, session);
+    }
+
+    StreamServer::StreamServer() {
+      memset(this->sent_buttons_, 0, sizeof(this->sent_buttons_));
+      memset(this->sent_axes_, 0, sizeof(this->sent_axes_));
+    }
+
+    StreamServer::~StreamServer() { close(); }
+
+    bool StreamServer::open(std::string host, uint16_t port) {
+      this->close();
+
+      sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      if (inet_pton(AF_INET, host.c_str(), &(addr.sin_addr)) != 1) {
+        return false;
+      }
+
+      int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if (sock < 0) {
+        return false;
+      }
+
+      // connect しておくと送信先の指定が不要になり，送信先からのパケットだけを受け取れる
+      if (connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(sock);
+        return false;
+      }
+
+      // 再起動前のサーバと区別できるよう，時刻と pid から 0 以外の値を作る
+      uint32_t session = static_cast<uint32_t>(trace::nowNs()) ^ (static_cast<uint32_t>(getpid()) << 16);
+      if (session == 0 || session == this->session_) {
+        session = this->session_ + 1;
+      }
+
+      this->sock_ = sock;
+      this->session_ = session;
+      this->seq_ = 0;
+      this->force_keyframe_ = true;
+      return true;
+    }
+
+    void StreamServer::close() {
+      if (this->sock_ >= 0) {
+        ::close(this->sock_);
+        this->sock_ = -1;
+      }
+    }
+
+    void StreamServer::receiveRequests() {
+      uint8_t request[HEADER_SIZE];
+
+      while (true) {
+        ssize_t size = recv(this->sock_, request, sizeof(request), 0);
+        if (size < 0) {
+          // ECONNREFUSED: 受信側がまだ開いていない (ICMP port unreachable)
+          if (errno != EAGAIN && errno != ECONNREFUSED) {
+            this->stats_.errors++;
+          }
+          return;
+        }
+
+        if (size >= 4 && get16(request) == MAGIC && (request[3] & FLAG_REQUEST)) {
+          this->force_keyframe_ = true;
+        }
+      }
+    }
+
+    bool StreamServer::sendState(const std::vector<bool>& buttons,
+                                 const std::vector<float>& axes,
+                                 int64_t timestamp_us) {
+      if (this->sock_ < 0) {
+        return false;
+      }
+
+      receiveRequests();
+
+      int button_num = (buttons.size() < MAX_BUTTONS) ? buttons.size() : MAX_BUTTONS;
+      int axis_num = (axes.size() < MAX_AXES) ? axes.size() : MAX_AXES;
+      int button_bytes = (button_num + 7) / 8;
+      int axis_bytes = (axis_num + 7) / 8;
+
+      int64_t now = trace::nowNs();
+      bool keyframe = this->force_keyframe_
+        || now - this->last_keyframe_ns_ >= static_cast<int64_t>(this->keyframe_interval_ms_) * 1000000;
+
+      uint8_t* body = this->packet_ + HEADER_SIZE;
+      int size = HEADER_SIZE;
+
+      if (keyframe) {
+        memset(body, 0, button_bytes);
+        for (int i = 0; i < button_num; i++) {
+          this->sent_buttons_[i] = buttons[i];
+          if (buttons[i]) {
+            body[i / 8] |= 1 << (i % 8);
+          }
+        }
+        size += button_bytes;
+
+        for (int i = 0; i < axis_num; i++) {
+          this->sent_axes_[i] = quantize(axes[i]);
+          put16(this->packet_ + size, this->sent_axes_[i]);
+          size += 2;
+        }
+      }
+      else {
+        // ボタン: 変化したものを 1 にしたマスク，軸: 量子化した値が変化したもののみ
+        uint8_t* button_mask = body;
+        uint8_t* axis_mask = body + button_bytes;
+        memset(body, 0, button_bytes + axis_bytes);
+        size += button_bytes + axis_bytes;
+        bool changed = false;
+
+        for (int i = 0; i < button_num; i++) {
+          if (buttons[i] != this->sent_buttons_[i]) {
+            this->sent_buttons_[i] = buttons[i];
+            button_mask[i / 8] |= 1 << (i % 8);
+            changed = true;
+          }
+        }
+
+        for (int i = 0; i < axis_num; i++) {
+          int16_t value = quantize(axes[i]);
+          if (value != this->sent_axes_[i]) {
+            this->sent_axes_[i] = value;
+            axis_mask[i / 8] |= 1 << (i % 8);
+            put16(this->packet_ + size, value);
+            size += 2;
+            changed = true;
+          }
+        }
+
+        if (!changed) {
+          return false;
+        }
+      }
+
+      writeHeader(this->packet_, keyframe ? FLAG_KEYFRAME : 0, this->session_, this->seq_,
+                  timestamp_us, button_num, axis_num);
+
+      if (::send(this->sock_, this->packet_, size, 0) != size) {
+        // 失敗したフレームの変化は失われるため，次はキーフレームを送る
+        if (errno != ECONNREFUSED) {
+          this->stats_.errors++;
+        }
+        this->force_keyframe_ = true;
+        return false;
+      }
+
+      this->seq_++;
+      this->stats_.packets++;
+      this->stats_.bytes += size;
+      if (keyframe) {
+        this->stats_.keyframes++;
+        this->last_keyframe_ns_ = now;
+        this->force_keyframe_ = false;
+      }
+      return true;
+    }
+
+    StreamClient::StreamClient(int button_num, int axis_num):
+      buttons_(button_num),
+      axes_(axis_num)
+    {
+
+    }
+
+    StreamClient::~StreamClient() { close(); }
+
+    bool StreamClient::open(uint16_t port, std::string bind_address) {
+      this->close();
+
+      sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      if (inet_pton(AF_INET, bind_address.c_str(), &(addr.sin_addr)) != 1) {
+        return false;
+      }
+
+      int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if (sock < 0) {
+        return false;
+      }
+
+      if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(sock);
+        return false;
+      }
+
+      this->sock_ = sock;
+      this->has_keyframe_ = false;
+      this->session_ = 0;
+      this->last_receive_ns_ = 0;
+      this->buttons_.clearData();
+      this->axes_.clearData();
+      return true;
+    }
+
+    void StreamClient::close() {
+      if (this->sock_ >= 0) {
+        ::close(this->sock_);
+        this->sock_ = -1;
+      }
+    }
+
+    bool StreamClient::isConnected() {
+      return this->sock_ >= 0 && this->last_receive_ns_ != 0
+        && trace::nowNs() - this->last_receive_ns_ < static_cast<int64_t>(CONNECTION_TIMEOUT_MS) * 1000000;
+    }
+
+    void StreamClient::requestKeyframe(const sockaddr_in& server) {
+      int64_t now = trace::nowNs();
+      if (now - this->last_request_ns_ < static_cast<int64_t>(KEYFRAME_REQUEST_INTERVAL_MS) * 1000000) {
+        return;
+      }
+
+      uint8_t request[HEADER_SIZE];
+      writeHeader(request, FLAG_REQUEST, this->session_, this->seq_, 0, 0, 0);
+      sendto(this->sock_, request, sizeof(request), 0,
+             reinterpret_cast<const sockaddr*>(&server), sizeof(server));
+
+      this->last_request_ns_ = now;
+      this->stats_.requests++;
+    }
+
+    /**
+     * @brief apply a received packet of `size` bytes
+     *
+     * @retval `false`: packet can not be applied (a keyframe should be requested)
+     */
+    bool StreamClient::applyPacket(int size) {
+      const uint8_t* p = this->packet_;
+      if (size < HEADER_SIZE || get16(p) != MAGIC || p[2] != VERSION) {
+        return true;
+      }
+
+      uint8_t flags = p[3];
+      uint32_t seq = get32(p + 4);
+      int64_t timestamp_us = get64(p + 8);
+      int button_num = get16(p + 16);
+      int axis_num = p[18];
+      int button_bytes = (button_num + 7) / 8;
+      int axis_bytes = (axis_num + 7) / 8;
+      uint32_t session = get32(p + 20);
+
+      if ((flags & FLAG_REQUEST) || button_num > MAX_BUTTONS || axis_num > MAX_AXES) {
+        return true;
+      }
+
+      // サーバが開き直されると sequence は 0 から振り直されるため，別の session とは比較しない
+      bool same_session = this->has_keyframe_ && session == this->session_;
+
+      // 古いフレーム・重複したフレームは無視 (sequence の周回を考慮)
+      int32_t diff = static_cast<int32_t>(seq - this->seq_);
+      if (same_session && diff <= 0) {
+        return true;
+      }
+
+      const uint8_t* body = p + HEADER_SIZE;
+      this->stats_.received++;
+      this->last_receive_ns_ = trace::nowNs();
+
+      if (!same_session && !(flags & FLAG_KEYFRAME)) {
+        // 新しい session の差分は基準がないため，キーフレームを待つ
+        this->has_keyframe_ = false;
+        this->stats_.discarded++;
+        return false;
+      }
+
+      if (flags & FLAG_KEYFRAME) {
+        if (size < HEADER_SIZE + button_bytes + axis_num * 2) {
+          return true;
+        }
+
+        if (same_session && diff > 1) {
+          this->stats_.lost += diff - 1;
+        }
+
+        const std::vector<bool>& states = this->buttons_.getData();
+        for (int i = 0; i < button_num && i < static_cast<int>(states.size()); i++) {
+          bool state = (body[i / 8] >> (i % 8)) & 1;
+          if (state != states[i]) {
+            this->buttons_.setState(i, state);
+          }
+        }
+
+        const uint8_t* values = body + button_bytes;
+        for (int i = 0; i < axis_num; i++) {
+          this->axes_.setValue(i, dequantize(static_cast<int16_t>(get16(values + i * 2))));
+        }
+
+        this->has_keyframe_ = true;
+        this->session_ = session;
+        this->stats_.keyframes++;
+      }
+      else {
+        if (!this->has_keyframe_ || diff != 1) {
+          // 差分の基準が失われているので次のキーフレームまで捨てる
+          if (this->has_keyframe_) {
+            this->stats_.lost += diff - 1;
+            this->has_keyframe_ = false;
+          }
+          this->stats_.discarded++;
+          return false;
+        }
+
+        if (size < HEADER_SIZE + button_bytes + axis_bytes) {
+          return true;
+        }
+
+        const uint8_t* button_mask = body;
+        const uint8_t* axis_mask = body + button_bytes;
+        const std::vector<bool>& states = this->buttons_.getData();
+
+        for (int i = 0; i < button_bytes; i++) {
+          uint8_t mask = button_mask[i];
+          while (mask != 0) {
+            int id = i * 8 + __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (id < static_cast<int>(states.size())) {
+              this->buttons_.setState(id, !states[id]);
+            }
+          }
+        }
+
+        const uint8_t* values = axis_mask + axis_bytes;
+        const uint8_t* end = p + size;
+        for (int i = 0; i < axis_bytes; i++) {
+          uint8_t mask = axis_mask[i];
+          while (mask != 0 && values + 2 <= end) {
+            int id = i * 8 + __builtin_ctz(mask);
+            mask &= mask - 1;
+            this->axes_.setValue(id, dequantize(static_cast<int16_t>(get16(values))));
+            values += 2;
+          }
+        }
+      }
+
+      this->seq_ = seq;
+      this->timestamp_us_ = timestamp_us;
+      return true;
+    }
+
+    void StreamClient::update() {
+      this->buttons_.clearEvents();
+
+      if (this->sock_ < 0) {
+        return;
+      }
+
+      while (true) {
+        sockaddr_in server;
+        socklen_t addr_len = sizeof(server);
+        ssize_t size = recvfrom(this->sock_, this->packet_, sizeof(this->packet_), 0,
+                                reinterpret_cast<sockaddr*>(&server), &addr_len);
+        if (size < 0) {
+          break;
+        }
+
+        if (!applyPacket(size)) {
+          requestKeyframe(server);
+        }
+      }
+    }
+  }
+}
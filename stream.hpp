@@ -0,0 +1,188 @@
+#ifndef PAD_STREAM_H
+#define PAD_STREAM_H
+
+#include <netinet/in.h>
+
+#include "gamepad.hpp"
+
+namespace pad {
+
+  namespace stream {
+
+    constexpr uint16_t MAGIC = 0x5044;          // "DP"
+    constexpr uint8_t  VERSION = 2;
+    constexpr int MAX_BUTTONS = 256;            // ボタン ID は uint8_t
+    constexpr int MAX_AXES = 64;                // 変化した軸は 64bit のマスクで管理
+    constexpr int HEADER_SIZE = 24;
+    constexpr int MAX_PACKET_SIZE = HEADER_SIZE + MAX_BUTTONS / 8 + MAX_AXES / 8 + MAX_AXES * 2;
+    constexpr int DEFAULT_KEYFRAME_INTERVAL_MS = 500;
+    constexpr int CONNECTION_TIMEOUT_MS = 2000;
+    constexpr int KEYFRAME_REQUEST_INTERVAL_MS = 100;
+
+    // flags
+    constexpr uint8_t FLAG_KEYFRAME = 1 << 0;   // 全状態を含むフレーム
+    constexpr uint8_t FLAG_REQUEST  = 1 << 1;   // クライアント -> サーバ: キーフレームの要求
+
+    struct ServerStats {
+      uint64_t packets;
+      uint64_t keyframes;
+      uint64_t bytes;
+      uint64_t errors;
+    };
+
+    struct ClientStats {
+      uint64_t received;
+      uint64_t keyframes;
+      uint64_t lost;       // 欠番のフレーム数
+      uint64_t discarded;  // 基準となるキーフレームがなく捨てたフレーム数
+      uint64_t requests;
+    };
+
+    /**
+     * @brief send pad state over UDP as per-frame deltas with periodic keyframes
+     *
+     * packet: header (magic, version, flags, sequence, kernel timestamp, number of inputs, session)
+     *   keyframe: button states (bitmask), all axes (int16)
+     *   delta:    changed button mask, changed axis mask, changed axes (int16)
+     * nothing is sent while the state does not change, except keyframes.
+     */
+    class StreamServer {
+     private:
+      int sock_{-1};
+      uint32_t session_{0};   // open() ごとに変わる値 (sequence が振り直されたことを受信側に伝える)
+      uint32_t seq_{0};
+      int keyframe_interval_ms_{DEFAULT_KEYFRAME_INTERVAL_MS};
+      int64_t last_keyframe_ns_{0};
+      bool force_keyframe_{true};
+
+      std::vector<bool>  buttons_;
+      std::vector<float> axes_;
+      bool    sent_buttons_[MAX_BUTTONS];
+      int16_t sent_axes_[MAX_AXES];
+      uint8_t packet_[MAX_PACKET_SIZE];
+      ServerStats stats_ = {0, 0, 0, 0};
+
+      void receiveRequests();
+
+     public:
+      StreamServer();
+      ~StreamServer();
+
+      /**
+       * @brief open UDP socket sending to `host:port` (IPv4 address)
+       *
+       */
+      bool open(std::string host, uint16_t port);
+      void close();
+
+      void setKeyframeInterval(int interval_ms) {
+        this->keyframe_interval_ms_ = interval_ms;
+      }
+
+      ServerStats getStats() {
+        return this->stats_;
+      }
+
+      /**
+       * @brief send changes since the last call (call after `update()` of the pad)
+       *
+       * @retval `true`: a packet was sent
+       */
+      bool sendState(const std::vector<bool>& buttons,
+                     const std::vector<float>& axes,
+                     int64_t timestamp_us);
+
+      template <typename Handler, typename E>
+      bool send(BasePad<Handler, E>& pad) {
+        pad.getButtonVec(this->buttons_);
+        pad.getAxisVec(this->axes_);
+        return sendState(this->buttons_, this->axes_, pad.getSyncTime());
+      }
+    };
+
+    /**
+     * @brief receive packets of `StreamServer` and rebuild the pad state
+     *
+     * the query API is the same as `BasePad`.
+     * deltas after a lost packet are discarded until the next keyframe (requested from the server).
+     * a keyframe of a new session (restarted server) always replaces the state.
+     */
+    class StreamClient {
+     private:
+      int sock_{-1};
+      ButtonData buttons_;
+      AxisData   axes_;
+      ClientStats stats_ = {0, 0, 0, 0, 0};
+
+      bool has_keyframe_{false};
+      uint32_t session_{0};
+      uint32_t seq_{0};
+      int64_t timestamp_us_{0};
+      int64_t last_receive_ns_{0};
+      int64_t last_request_ns_{0};
+      uint8_t packet_[MAX_PACKET_SIZE];
+
+      bool applyPacket(int size);
+      void requestKeyframe(const sockaddr_in& server);
+
+     public:
+      StreamClient(int button_num = DEFAULT_BUTTON_NUM, int axis_num = DEFALUT_AXIS_NUM);
+      ~StreamClient();
+
+      /**
+       * @brief open UDP socket receiving on `port`
+       *
+       */
+      bool open(uint16_t port, std::string bind_address = "0.0.0.0");
+      void close();
+
+      /**
+       * @brief apply all received packets
+       *
+       */
+      void update();
+
+      // 直近 CONNECTION_TIMEOUT_MS 以内にパケットを受信したか
+      bool isConnected();
+
+      ClientStats getStats() {
+        return this->stats_;
+      }
+
+      uint32_t getSequence() {
+        return this->seq_;
+      }
+
+      // 送信元でのカーネルタイムスタンプ [us]
+      int64_t getTimestamp() {
+        return this->timestamp_us_;
+      }
+
+      std::vector<bool> getButtonVec() {
+        return this->buttons_.getVector();
+      }
+
+      std::vector<float> getAxisVec() {
+        return this->axes_.getVector();
+      }
+
+      bool press(uint8_t id) {
+        return this->buttons_.getState(id);
+      }
+
+      bool pushed(uint8_t id) {
+        return this->buttons_.pushed(id);
+      }
+
+      bool released(uint8_t id) {
+        return this->buttons_.released(id);
+      }
+
+      float axisValue(uint8_t id) {
+        return this->axes_.getValue(id);
+      }
+    };
+  }
+}
+
+#endif // PAD_STREAM_H
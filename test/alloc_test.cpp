@@ -0,0 +1,132 @@
+// update() と状態の読み出しがヒープを確保しないことを確認する
+// デバイスの代わりに FIFO へ input_event を書き込む
+
+#include <sys/stat.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "gamepad.hpp"
+#include "ps5/ps5pad.hpp"
+
+static bool g_counting = false;
+static long g_allocations = 0;
+
+void* operator new(size_t size) {
+  if (g_counting) {
+    g_allocations++;
+  }
+
+  void* p = malloc(size ? size : 1);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+using namespace pad;
+
+static int g_failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      g_failures++; \
+    } \
+  } while (0)
+
+constexpr int ITERATIONS = 1000;
+constexpr uint64_t EVENTS_PER_ITERATION = 3;  // BTN_SOUTH, ABS_X, ABS_HAT0X
+
+static void writeEvent(int fd, uint16_t type, uint16_t code, int32_t value) {
+  input_event event = {};
+  event.type = type;
+  event.code = code;
+  event.value = value;
+  if (write(fd, &event, sizeof(event)) != sizeof(event)) {
+    perror("write");
+  }
+}
+
+static long run(const char* name, const RealtimeConfig& config, bool coalesce) {
+  const char* fifo = "/tmp/linux_pad_alloc_test";
+  unlink(fifo);
+  mkfifo(fifo, 0600);
+
+  GamePad<ps5::PS5Handler> pad(fifo, ps5::dev::num_buttons, ps5::dev::num_axes);
+  int fd = open(fifo, O_WRONLY | O_NONBLOCK);
+  pad.setRealtimeConfig(config);
+  pad.setAxisCoalescing(coalesce);
+
+  std::vector<bool>  buttons(ps5::dev::num_buttons);
+  std::vector<float> axes(ps5::dev::num_axes);
+  long count = 0;
+
+  for (int i = 0; i < ITERATIONS; i++) {
+    writeEvent(fd, EV_KEY, BTN_SOUTH, i % 2);
+    writeEvent(fd, EV_ABS, ABS_X, i % 256);
+    writeEvent(fd, EV_ABS, ABS_HAT0X, (i % 3) - 1);
+    writeEvent(fd, EV_SYN, SYN_REPORT, 0);
+    if (config.reader_thread) {
+      usleep(100);
+    }
+
+    g_allocations = 0;
+    g_counting = true;
+    pad.update();
+    pad.press(ps5::ButtonID::cross);
+    pad.pushed(ps5::ButtonID::cross);
+    pad.released(ps5::ButtonID::left);
+    pad.axisValue(ps5::AxisID::leftX);
+    pad.getButtonVec(buttons);
+    pad.getAxisVec(axes);
+    pad.getMetrics();
+    g_counting = false;
+    count += g_allocations;
+  }
+
+  // reader thread では最後の数フレームがまだキューに届いていないことがある
+  const uint64_t expected_events = ITERATIONS * EVENTS_PER_ITERATION;
+  for (int retry = 0; retry < 100 && pad.getMetrics().events < expected_events; retry++) {
+    usleep(1000);
+    pad.update();
+  }
+
+  close(fd);
+  unlink(fifo);
+
+  uint64_t events = pad.getMetrics().events;
+  printf("%-16s allocations: %ld, events: %llu\n", name, count,
+         static_cast<unsigned long long>(events));
+
+  // 最後のフレーム (i = 999): cross 押下, ABS_X = 231, HAT0X = -1 (左)
+  int last = ITERATIONS - 1;
+  float expected_x = static_cast<float>((last % 256) * 2 - 255) / 255;
+  CHECK(events == expected_events);
+  CHECK(pad.press(ps5::ButtonID::cross));
+  CHECK(pad.press(ps5::ButtonID::left));
+  CHECK(fabs(pad.axisValue(ps5::AxisID::leftX) - expected_x) < 1e-3f);
+  return count;
+}
+
+int main() {
+  RealtimeConfig direct;
+  RealtimeConfig threaded;
+  threaded.reader_thread = true;
+
+  long total = 0;
+  total += run("direct", direct, false);
+  total += run("direct+coalesce", direct, true);
+  total += run("reader thread", threaded, false);
+
+  CHECK(total == 0);
+
+  printf("%s\n", (g_failures == 0) ? "alloc_test: OK" : "alloc_test: FAILED");
+  return (g_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,186 @@
+// FeedbackQueue を pipe に attach() して書き出される input_event を確認する
+//   play / stop / gain の出力, キュー内での上書き, 一杯のときの破棄, rumble() の取りこぼし
+//   EVIOCSFF / EVIOCRMFF はこのファイルの ioctl() が代わりに答える (pipe には効かないため)
+
+#include <poll.h>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <atomic>
+
+#include "feedback.hpp"
+
+using namespace pad;
+
+static int g_failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      g_failures++; \
+    } \
+  } while (0)
+
+static int g_fd = -1;                       // attach() した pipe
+static std::atomic<bool> g_gate{true};      // false の間 EVIOCSFF で止める
+static std::atomic<bool> g_blocked{false};  // worker が EVIOCSFF で止まっている
+static std::atomic<int>  g_next_id{0};
+static std::atomic<int>  g_rumble_uploads{0};
+static std::atomic<int>  g_removed{0};
+
+// g_fd への EVIOCSFF / EVIOCRMFF だけを受け持つ (それ以外は失敗させる)
+extern "C" int ioctl(int fd, unsigned long request, ...) {
+  va_list args;
+  va_start(args, request);
+  void* arg = va_arg(args, void*);
+  va_end(args);
+
+  if (fd != g_fd) {
+    errno = ENOTTY;
+    return -1;
+  }
+
+  if (request == EVIOCSFF) {
+    g_blocked = true;
+    while (!g_gate) {
+      usleep(100);
+    }
+    g_blocked = false;
+
+    ff_effect* effect = static_cast<ff_effect*>(arg);
+    if (effect->type == FF_RUMBLE) {
+      g_rumble_uploads++;
+    }
+    if (effect->id < 0) {
+      effect->id = g_next_id++;
+    }
+    return 0;
+  }
+
+  if (request == EVIOCRMFF) {
+    g_removed++;
+    return 0;
+  }
+
+  errno = ENOTTY;
+  return -1;
+}
+
+// 書き出された input_event を `num` 個まで読む (1 秒で打ち切り)
+static int readEvents(int fd, input_event* events, int num) {
+  int count = 0;
+  while (count < num) {
+    pollfd p = {fd, POLLIN, 0};
+    if (poll(&p, 1, 1000) <= 0) {
+      break;
+    }
+    if (read(fd, &events[count], sizeof(input_event)) != sizeof(input_event)) {
+      break;
+    }
+    count++;
+  }
+  return count;
+}
+
+static ff_effect constantEffect() {
+  ff_effect effect;
+  memset(&effect, 0, sizeof(effect));
+  effect.type = FF_CONSTANT;
+  effect.id = -1;
+  effect.replay.length = 100;
+  return effect;
+}
+
+int main() {
+  int pipe_fd[2];
+  CHECK(pipe(pipe_fd) == 0);
+  g_fd = pipe_fd[1];
+
+  FeedbackQueue queue;
+  CHECK(queue.attach(g_fd));
+
+  // worker を slot 7 の upload で止めておき，その間にキューを操作する
+  // (worker がロックを持つ一瞬に当たると捨てられるので，止まっていない間は積めるまで繰り返す)
+  g_gate = false;
+  while (!queue.upload(7, constantEffect())) {
+    usleep(100);
+  }
+  uint32_t dropped = queue.getDroppedCount();
+  while (!g_blocked) {
+    usleep(100);
+  }
+
+  CHECK(queue.play(0));
+  CHECK(queue.stop(0));       // play(0) を上書き
+  CHECK(queue.play(0, 3));    // stop(0) を上書き
+  CHECK(queue.setGain(0x1000));
+  CHECK(queue.setGain(0x8000));
+  CHECK(queue.getCoalescedCount() == 3);
+
+  // 上書きできないコマンドで一杯にする (2 + 12 + 2 = 16)
+  for (uint8_t slot = 1; slot <= 6; slot++) {
+    CHECK(queue.upload(slot, constantEffect()));
+    CHECK(queue.play(slot));
+  }
+  CHECK(queue.upload(7, constantEffect()));
+  CHECK(queue.play(7));
+  CHECK(queue.getDroppedCount() == dropped);
+
+  CHECK(!queue.upload(0, constantEffect()));
+  CHECK(queue.getDroppedCount() == dropped + 1);
+
+  // play は上書きできても upload の空きがないので両方捨てる
+  CHECK(!queue.rumble(1.0f, 0.5f, 100));
+  CHECK(queue.getDroppedCount() == dropped + 3);
+  CHECK(queue.getCoalescedCount() == 3);
+
+  // 上書きだけで済むコマンドは一杯でも積める
+  CHECK(queue.setGain(0xc000));
+  CHECK(queue.getCoalescedCount() == 4);
+
+  g_gate = true;
+
+  // slot 0 は upload されていないので play(0) は失敗 (書き出しなし)
+  // 残り: gain, play(1 ~ 6), play(7)
+  input_event events[16];
+  int count = readEvents(pipe_fd[0], events, 8);
+  CHECK(count == 8);
+  if (count == 8) {
+    CHECK(events[0].type == EV_FF && events[0].code == FF_GAIN && events[0].value == 0xc000);
+    for (int slot = 1; slot <= 6; slot++) {
+      // effect id は upload 順 (slot 7 が 0, slot n が n)
+      CHECK(events[slot].type == EV_FF && events[slot].code == slot && events[slot].value == 1);
+    }
+    CHECK(events[7].type == EV_FF && events[7].code == 0 && events[7].value == 1);
+  }
+  CHECK(queue.getErrorCount() == 1);
+  CHECK(g_rumble_uploads == 0);
+
+  // 空いた後の stop / rumble
+  while (!queue.stop(3)) {
+    usleep(100);
+  }
+  count = readEvents(pipe_fd[0], events, 1);
+  CHECK(count == 1 && events[0].code == 3 && events[0].value == 0);
+
+  while (!queue.rumble(1.0f, 0.5f, 100)) {
+    usleep(100);
+  }
+  count = readEvents(pipe_fd[0], events, 1);
+  CHECK(count == 1 && events[0].code == 7 && events[0].value == 1);
+  CHECK(g_rumble_uploads == 1);
+
+  // close() で upload した effect (slot 0 ~ 7) を消す
+  queue.close();
+  CHECK(g_removed == 8);
+  CHECK(!queue.play(1));
+
+  ::close(pipe_fd[0]);
+  ::close(pipe_fd[1]);
+
+  printf("%s\n", (g_failures == 0) ? "feedback_test: OK" : "feedback_test: FAILED");
+  return (g_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
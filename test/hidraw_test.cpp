@@ -0,0 +1,203 @@
+// parseHidReport / HidrawPad のレポートのデコードを確認する
+//   USB (0x01, 64byte), BT 拡張 (0x31, 78byte), BT 簡易 (0x01, 10byte) の各レイアウト
+//   十字キー (斜め・ニュートラル含む), 各ボタンのビット, Y軸の反転, トリガー, 不正なレポートの拒否
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "ps5/ps5hidraw.hpp"
+
+using namespace pad;
+using namespace pad::ps5;
+
+static int g_failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      g_failures++; \
+    } \
+  } while (0)
+
+// テスト側で持つレイアウト (ps5hidraw.cpp とは独立に書く)
+struct Layout {
+  const char* name;
+  uint8_t id;
+  size_t  size;
+  uint8_t axis[dev::num_axes];  // AxisID 順
+  uint8_t buttons[3];
+};
+
+static const Layout layouts[] = {
+  {"usb",       hid::usb_report_id, hid::usb_report_size,       {1, 2, 5, 3, 4, 6}, {8, 9, 10}},
+  {"bt",        hid::bt_report_id,  hid::bt_report_size,        {2, 3, 6, 4, 5, 7}, {9, 10, 11}},
+  {"bt_simple", hid::usb_report_id, hid::bt_simple_report_size, {1, 2, 8, 3, 4, 9}, {5, 6, 7}},
+};
+
+static bool near(float a, float b) {
+  return fabs(a - b) < 1e-3f;
+}
+
+static uint32_t bit(uint8_t id) {
+  return 1u << id;
+}
+
+// スティック中立, トリガー 0, ボタンなし (hat = 8) のレポート
+static void makeReport(const Layout& layout, uint8_t* report) {
+  memset(report, 0, hid::max_report_size);
+  report[0] = layout.id;
+  for (int i = 0; i < dev::num_axes; i++) {
+    report[layout.axis[i]] = 0x80;
+  }
+  report[layout.axis[AxisID::L2depth]] = 0;
+  report[layout.axis[AxisID::R2depth]] = 0;
+  report[layout.buttons[0]] = 0x08;
+}
+
+static void testHat(const Layout& layout) {
+  // hat: 0 = 上から時計回り, 8 = ニュートラル
+  const uint32_t expected[9] = {
+    bit(ButtonID::up),
+    bit(ButtonID::up)    | bit(ButtonID::right),
+    bit(ButtonID::right),
+    bit(ButtonID::right) | bit(ButtonID::down),
+    bit(ButtonID::down),
+    bit(ButtonID::down)  | bit(ButtonID::left),
+    bit(ButtonID::left),
+    bit(ButtonID::left)  | bit(ButtonID::up),
+    0
+  };
+
+  uint8_t report[hid::max_report_size];
+  for (int hat = 0; hat <= 8; hat++) {
+    makeReport(layout, report);
+    report[layout.buttons[0]] = hat;
+
+    HidState state;
+    CHECK(parseHidReport(report, layout.size, state));
+    if (state.buttons != expected[hat]) {
+      printf("FAILED %s: hat %d -> 0x%05x (expected 0x%05x)\n",
+             layout.name, hat, state.buttons, expected[hat]);
+      g_failures++;
+    }
+  }
+}
+
+static void testButtons(const Layout& layout) {
+  uint8_t report[hid::max_report_size];
+  HidState state;
+
+  // 上位4bit: square, cross, circle, triangle
+  const uint8_t face_ids[4] = {ButtonID::square, ButtonID::cross, ButtonID::circle, ButtonID::triangle};
+  for (int i = 0; i < 4; i++) {
+    makeReport(layout, report);
+    report[layout.buttons[0]] = 0x08 | (0x10 << i);
+    CHECK(parseHidReport(report, layout.size, state));
+    CHECK(state.buttons == bit(face_ids[i]));
+  }
+
+  // L1, R1, L2, R2, create, option, L3, R3
+  const uint8_t shoulder_ids[8] = {
+    ButtonID::L1, ButtonID::R1, ButtonID::L2, ButtonID::R2,
+    ButtonID::create, ButtonID::option, ButtonID::L3, ButtonID::R3
+  };
+  for (int i = 0; i < 8; i++) {
+    makeReport(layout, report);
+    report[layout.buttons[1]] = 1 << i;
+    CHECK(parseHidReport(report, layout.size, state));
+    CHECK(state.buttons == bit(shoulder_ids[i]));
+  }
+
+  makeReport(layout, report);
+  report[layout.buttons[2]] = 0x01;
+  CHECK(parseHidReport(report, layout.size, state));
+  CHECK(state.buttons == bit(ButtonID::ps));
+
+  // 生の軸の値は AxisID 順
+  makeReport(layout, report);
+  for (int i = 0; i < dev::num_axes; i++) {
+    report[layout.axis[i]] = 10 + i;
+  }
+  CHECK(parseHidReport(report, layout.size, state));
+  for (int i = 0; i < dev::num_axes; i++) {
+    CHECK(state.axes[i] == 10 + i);
+  }
+}
+
+static void testPad(const Layout& layout) {
+  HidrawPad pad("/nonexistent/hidraw");
+  CHECK(!pad.isConnected());
+
+  uint8_t report[hid::max_report_size];
+  makeReport(layout, report);
+  report[layout.axis[AxisID::leftX]]   = 255;
+  report[layout.axis[AxisID::leftY]]   = 0;    // 上いっぱい -> +1.0
+  report[layout.axis[AxisID::rightX]]  = 0;
+  report[layout.axis[AxisID::rightY]]  = 255;  // 下いっぱい -> -1.0
+  report[layout.axis[AxisID::L2depth]] = 255;
+  report[layout.axis[AxisID::R2depth]] = 0;
+  report[layout.buttons[0]] = 0x20 | 0x02;     // cross + right
+  pad.updateFromReport(report, layout.size);
+
+  CHECK(near(pad.axisValue(AxisID::leftX), 1.0f));
+  CHECK(near(pad.axisValue(AxisID::leftY), 1.0f));
+  CHECK(near(pad.axisValue(AxisID::rightX), -1.0f));
+  CHECK(near(pad.axisValue(AxisID::rightY), -1.0f));
+  CHECK(near(pad.axisValue(AxisID::L2depth), 1.0f));
+  CHECK(near(pad.axisValue(AxisID::R2depth), 0.0f));
+  CHECK(pad.press(ButtonID::cross) && pad.pushed(ButtonID::cross));
+  CHECK(pad.press(ButtonID::right) && pad.pushed(ButtonID::right));
+
+  // 中立に戻す
+  makeReport(layout, report);
+  pad.updateFromReport(report, layout.size);
+  CHECK(near(pad.axisValue(AxisID::leftY), 0.0f));
+  CHECK(near(pad.axisValue(AxisID::L2depth), 0.0f));
+  CHECK(!pad.press(ButtonID::cross) && pad.released(ButtonID::cross));
+  CHECK(!pad.press(ButtonID::right) && pad.released(ButtonID::right));
+
+  // 不正なレポートは状態を変えない
+  makeReport(layout, report);
+  report[layout.buttons[0]] = 0x20 | 0x08;
+  report[0] = 0x02;
+  pad.updateFromReport(report, layout.size);
+  CHECK(!pad.press(ButtonID::cross));
+}
+
+static void testReject() {
+  uint8_t report[hid::max_report_size];
+  HidState state;
+
+  memset(report, 0, sizeof(report));
+  CHECK(!parseHidReport(report, 0, state));
+
+  // 短いレポート
+  report[0] = hid::usb_report_id;
+  CHECK(!parseHidReport(report, hid::bt_simple_report_size - 1, state));
+  CHECK(!parseHidReport(report, 1, state));
+
+  report[0] = hid::bt_report_id;
+  CHECK(!parseHidReport(report, hid::bt_report_size - 1, state));
+  CHECK(!parseHidReport(report, hid::usb_report_size, state));
+
+  // 未知のレポート ID
+  const uint8_t unknown_ids[] = {0x00, 0x02, 0x05, 0x11, 0x30, 0x32, 0xff};
+  for (uint8_t id: unknown_ids) {
+    report[0] = id;
+    CHECK(!parseHidReport(report, hid::max_report_size, state));
+  }
+}
+
+int main() {
+  for (const Layout& layout: layouts) {
+    testHat(layout);
+    testButtons(layout);
+    testPad(layout);
+  }
+  testReject();
+
+  printf("%s\n", (g_failures == 0) ? "hidraw_test: OK" : "hidraw_test: FAILED");
+  return (g_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,123 @@
+// StreamServer / StreamClient を 127.0.0.1 で接続して状態の復元を確認する
+//   差分・キーフレーム, 欠番からの復帰, サーバの再起動 (sequence の振り直し)
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "stream.hpp"
+
+using namespace pad;
+using namespace pad::stream;
+
+static int g_failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      g_failures++; \
+    } \
+  } while (0)
+
+constexpr int BUTTONS = 20;
+constexpr int AXES = 8;
+
+static bool near(float a, float b) {
+  return fabs(a - b) < 1e-3f;
+}
+
+// 受信が届くまで少し待ってから update()
+static void receive(StreamClient& client) {
+  usleep(2000);
+  client.update();
+}
+
+int main() {
+  StreamClient client(BUTTONS, AXES);
+  uint16_t port = 0;
+  for (uint16_t p = 47000; p < 47100; p++) {
+    if (client.open(p, "127.0.0.1")) {
+      port = p;
+      break;
+    }
+  }
+  CHECK(port != 0);
+
+  std::vector<bool>  buttons(BUTTONS, false);
+  std::vector<float> axes(AXES, 0.0f);
+
+  // 最初はキーフレーム, 以降は変化した分だけ
+  {
+    StreamServer server;
+    CHECK(server.open("127.0.0.1", port));
+
+    CHECK(server.sendState(buttons, axes, 100));
+    buttons[3] = true;
+    axes[1] = 0.5f;
+    CHECK(server.sendState(buttons, axes, 200));
+    CHECK(!server.sendState(buttons, axes, 300));  // 変化なし
+
+    receive(client);
+    CHECK(client.isConnected());
+    CHECK(client.press(3) && client.pushed(3));
+    CHECK(near(client.axisValue(1), 0.5f));
+    CHECK(client.getSequence() == 1);
+    CHECK(client.getTimestamp() == 200);
+
+    ServerStats stats = server.getStats();
+    CHECK(stats.packets == 2 && stats.keyframes == 1);
+
+    for (int i = 0; i < 8; i++) {
+      axes[2] = (i + 1) * 0.1f;
+      server.sendState(buttons, axes, 300 + i);
+    }
+    receive(client);
+    CHECK(client.getSequence() == 9);
+    CHECK(!client.pushed(3));
+    CHECK(near(client.axisValue(2), 0.8f));
+  }
+
+  // サーバの再起動: sequence は 0 から振り直されるが，新しいキーフレームで置き換わる
+  {
+    StreamServer server;
+    CHECK(server.open("127.0.0.1", port));
+
+    buttons[3] = false;
+    buttons[5] = true;
+    axes[1] = -0.25f;
+    CHECK(server.sendState(buttons, axes, 1000));
+
+    receive(client);
+    CHECK(client.getSequence() == 0);
+    CHECK(client.getTimestamp() == 1000);
+    CHECK(!client.press(3) && client.released(3));
+    CHECK(client.press(5) && client.pushed(5));
+    CHECK(near(client.axisValue(1), -0.25f));
+
+    buttons[6] = true;
+    CHECK(server.sendState(buttons, axes, 1100));
+    receive(client);
+    CHECK(client.press(6) && client.getSequence() == 1);
+
+    // 欠番: 受信側を開き直すと途中の差分は失われ，キーフレームを要求して復帰する
+    client.close();
+    buttons[6] = false;
+    server.sendState(buttons, axes, 1200);
+    CHECK(client.open(port, "127.0.0.1"));
+
+    buttons[7] = true;
+    server.sendState(buttons, axes, 1300);
+    receive(client);
+    CHECK(!client.press(7));
+    CHECK(client.getStats().requests == 1);
+
+    server.sendState(buttons, axes, 1400);  // 要求を受けてキーフレーム
+    receive(client);
+    CHECK(client.press(7) && !client.press(6) && client.press(5));
+    CHECK(near(client.axisValue(1), -0.25f));
+    CHECK(server.getStats().keyframes == 2);
+  }
+
+  printf("%s\n", (g_failures == 0) ? "stream_test: OK" : "stream_test: FAILED");
+  return (g_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,75 @@
+// update() の実行時間を計測し PadMetrics を表示する
+// usage: update_bench [iterations] [cpu] [priority]
+//   cpu / priority を指定すると reader スレッドに適用する (SCHED_FIFO には CAP_SYS_NICE が必要)
+
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "gamepad.hpp"
+#include "ps5/ps5pad.hpp"
+
+using namespace pad;
+
+static void writeFrame(int fd, int i) {
+  input_event events[4] = {};
+  events[0].type = EV_KEY; events[0].code = BTN_SOUTH; events[0].value = i % 2;
+  events[1].type = EV_ABS; events[1].code = ABS_X;     events[1].value = i % 256;
+  events[2].type = EV_ABS; events[2].code = ABS_Y;     events[2].value = 255 - i % 256;
+  events[3].type = EV_SYN; events[3].code = SYN_REPORT;
+  if (write(fd, events, sizeof(events)) != sizeof(events)) {
+    perror("write");
+  }
+}
+
+static void bench(const char* name, int iterations, const RealtimeConfig& config, bool coalesce) {
+  const char* fifo = "/tmp/linux_pad_update_bench";
+  unlink(fifo);
+  mkfifo(fifo, 0600);
+
+  GamePad<ps5::PS5Handler> pad(fifo, ps5::dev::num_buttons, ps5::dev::num_axes);
+  int fd = open(fifo, O_WRONLY | O_NONBLOCK);
+  if (!pad.setRealtimeConfig(config)) {
+    printf("%s: real-time configuration is not applied\n", name);
+  }
+  pad.setAxisCoalescing(coalesce);
+
+  int64_t total_ns = 0;
+  for (int i = 0; i < iterations; i++) {
+    writeFrame(fd, i);
+    if (config.reader_thread) {
+      usleep(50);
+    }
+
+    pad.update();
+    total_ns += pad.getMetrics().last_update_ns;
+  }
+
+  PadMetrics metrics = pad.getMetrics();
+  printf("%-16s updates: %llu  events: %llu  dropped: %llu  avg: %lld ns  max: %lld ns\n",
+         name,
+         static_cast<unsigned long long>(metrics.updates),
+         static_cast<unsigned long long>(metrics.events),
+         static_cast<unsigned long long>(metrics.dropped_events),
+         static_cast<long long>(total_ns / iterations),
+         static_cast<long long>(metrics.max_update_ns));
+
+  close(fd);
+  unlink(fifo);
+}
+
+int main(int argc, char** argv) {
+  int iterations = (argc > 1) ? atoi(argv[1]) : 10000;
+
+  RealtimeConfig direct;
+  RealtimeConfig threaded;
+  threaded.reader_thread = true;
+  threaded.cpu = (argc > 2) ? atoi(argv[2]) : -1;
+  threaded.priority = (argc > 3) ? atoi(argv[3]) : 0;
+
+  bench("direct", iterations, direct, false);
+  bench("direct+coalesce", iterations, direct, true);
+  bench("reader thread", iterations, threaded, false);
+  return 0;
+}
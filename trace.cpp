@@ -0,0 +1,285 @@
+#include "trace.hpp"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace pad {
+
+  namespace trace {
+
+    namespace detail {
+      std::atomic<bool> enabled{false};
+    }
+
+    namespace {
+      constexpr int num_stages = 5;
+
+      const char* const span_names[num_stages] = {
+        "",
+        "kernel->read",
+        "read->decode",
+        "decode->update",
+        "update->consume"
+      };
+
+      // スレッドごとのリングバッファ (enable() で確保し，スレッド終了後も dump できるよう解放しない)
+      constexpr int BUFFER_FREE     = 0;
+      constexpr int BUFFER_CLAIMED  = 1;
+      constexpr int BUFFER_RESIZING = 2;
+
+      struct ThreadBuffer {
+        std::vector<TraceRecord> records;
+        std::atomic<uint64_t> written{0};
+        std::atomic<int> state{BUFFER_FREE};
+        uint64_t current_seq{0};
+        uint64_t local_seq{0};
+        uint64_t index{0};
+        long tid{0};
+      };
+
+      std::mutex   registry_mutex;
+      ThreadBuffer registry[MAX_TRACE_THREADS];
+
+      thread_local ThreadBuffer* tls_buffer = nullptr;
+
+      /**
+       * @brief buffer of this thread, a free buffer of the pool is claimed on the first call
+       *
+       * no allocation nor lock here (called from the reader thread)
+       * @retval `nullptr`: all buffers are used by other threads (events of this thread are not recorded)
+       */
+      ThreadBuffer* threadBuffer() {
+        if (tls_buffer != nullptr) {
+          return tls_buffer;
+        }
+
+        for (int i = 0; i < MAX_TRACE_THREADS; i++) {
+          ThreadBuffer& buffer = registry[i];
+          int expected = BUFFER_FREE;
+          if (!buffer.state.compare_exchange_strong(expected, BUFFER_CLAIMED, std::memory_order_acquire)) {
+            continue;
+          }
+
+          if (buffer.records.empty()) {
+            buffer.state.store(BUFFER_FREE, std::memory_order_release);
+            return nullptr;
+          }
+
+          // 解放済みのバッファを再利用する場合も記録と通し番号は引き継ぐ
+          buffer.index = i + 1;
+          buffer.tid = syscall(SYS_gettid);
+          tls_buffer = &buffer;
+          return tls_buffer;
+        }
+
+        return nullptr;
+      }
+
+      void push(ThreadBuffer* buffer, const TraceRecord& record) {
+        size_t size = buffer->records.size();
+        if (size == 0) {
+          return;
+        }
+
+        uint64_t n = buffer->written.load(std::memory_order_relaxed);
+        buffer->records[n % size] = record;
+        buffer->written.store(n + 1, std::memory_order_release);
+      }
+
+      struct EventPoints {
+        int64_t  time_ns[num_stages];
+        long     tid[num_stages];
+        uint16_t code;
+      };
+    }
+
+    void enable(size_t capacity_per_thread) {
+      {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+
+        // 使用中のバッファはそのまま (サイズの変更は解放後の enable() で反映)
+        for (ThreadBuffer& buffer: registry) {
+          int expected = BUFFER_FREE;
+          if (!buffer.state.compare_exchange_strong(expected, BUFFER_RESIZING, std::memory_order_acquire)) {
+            continue;
+          }
+
+          if (buffer.records.size() != capacity_per_thread) {
+            buffer.records.assign(capacity_per_thread, TraceRecord());
+            buffer.written.store(0, std::memory_order_relaxed);
+          }
+          buffer.state.store(BUFFER_FREE, std::memory_order_release);
+        }
+      }
+
+      detail::enabled.store(true, std::memory_order_relaxed);
+    }
+
+    void disable() {
+      detail::enabled.store(false, std::memory_order_relaxed);
+    }
+
+    void clear() {
+      std::lock_guard<std::mutex> lock(registry_mutex);
+      for (ThreadBuffer& buffer: registry) {
+        buffer.written.store(0, std::memory_order_relaxed);
+      }
+    }
+
+    void releaseThread() {
+      if (tls_buffer == nullptr) {
+        return;
+      }
+
+      tls_buffer->state.store(BUFFER_FREE, std::memory_order_release);
+      tls_buffer = nullptr;
+    }
+
+    uint64_t beginEvent(const timeval& kernel_time, uint16_t code) {
+      ThreadBuffer* buffer = threadBuffer();
+      if (buffer == nullptr) {
+        return 0;
+      }
+
+      // 同一スレッド内で連番になるよう上位ビットにバッファ番号を置く
+      uint64_t seq = (buffer->index << 40) | ++buffer->local_seq;
+      buffer->current_seq = seq;
+
+      int64_t kernel_ns = static_cast<int64_t>(kernel_time.tv_sec) * 1000000000
+                        + static_cast<int64_t>(kernel_time.tv_usec) * 1000;
+
+      push(buffer, {seq, 1, code, Stage::Kernel, kernel_ns});
+      push(buffer, {seq, 1, code, Stage::Read, nowNs()});
+      return seq;
+    }
+
+    void record(Stage stage) {
+      ThreadBuffer* buffer = threadBuffer();
+      if (buffer != nullptr && buffer->current_seq != 0) {
+        push(buffer, {buffer->current_seq, 1, 0, stage, nowNs()});
+      }
+    }
+
+    void recordConsume(uint64_t first_seq, uint32_t count) {
+      ThreadBuffer* buffer = threadBuffer();
+      if (buffer != nullptr) {
+        push(buffer, {first_seq, count, 0, Stage::Consume, nowNs()});
+      }
+    }
+
+    uint64_t currentSeq() {
+      ThreadBuffer* buffer = threadBuffer();
+      return (buffer != nullptr) ? buffer->current_seq : 0;
+    }
+
+    void setCurrentSeq(uint64_t seq) {
+      ThreadBuffer* buffer = threadBuffer();
+      if (buffer != nullptr) {
+        buffer->current_seq = seq;
+      }
+    }
+
+    /**
+     * @brief write recorded points as "X" (complete) events, one slice per stage transition
+     *
+     * @retval `true`: succeed in writing `path`
+     * @retval `false`: fail to open `path`
+     */
+    bool dumpChromeTrace(const std::string& path) {
+      std::map<uint64_t, EventPoints> events;
+      std::vector<long> tids;
+
+      {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+
+        for (ThreadBuffer& slot: registry) {
+          ThreadBuffer* buffer = &slot;
+          uint64_t written = buffer->written.load(std::memory_order_acquire);
+          uint64_t size    = buffer->records.size();
+          if (written == 0 || size == 0) {
+            continue;
+          }
+          tids.push_back(buffer->tid);
+
+          uint64_t begin   = (written > size) ? written - size : 0;
+
+          for (uint64_t i = begin; i < written; i++) {
+            const TraceRecord& record = buffer->records[i % size];
+            int stage = static_cast<int>(record.stage);
+
+            for (uint32_t k = 0; k < record.count; k++) {
+              auto it = events.find(record.seq + k);
+              if (it == events.end()) {
+                EventPoints points;
+                for (int s = 0; s < num_stages; s++) {
+                  points.time_ns[s] = -1;
+                  points.tid[s] = 0;
+                }
+                points.code = 0;
+                it = events.emplace(record.seq + k, points).first;
+              }
+
+              EventPoints& points = it->second;
+              // Consume は最初の読み出しのみ採用
+              if (record.stage == Stage::Consume && points.time_ns[stage] >= 0) {
+                continue;
+              }
+              points.time_ns[stage] = record.time_ns;
+              points.tid[stage] = buffer->tid;
+              if (record.stage == Stage::Kernel) {
+                points.code = record.code;
+              }
+            }
+          }
+        }
+      }
+
+      FILE* fp = fopen(path.c_str(), "w");
+      if (fp == nullptr) {
+        return false;
+      }
+
+      long pid = getpid();
+      bool first = true;
+      fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+      for (long tid: tids) {
+        fprintf(fp, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%ld,\"tid\":%ld,"
+                    "\"args\":{\"name\":\"pad %ld\"}}",
+                first ? "" : ",\n", pid, tid, tid);
+        first = false;
+      }
+
+      for (auto& entry: events) {
+        const EventPoints& points = entry.second;
+        int prev = -1;
+
+        for (int s = 0; s < num_stages; s++) {
+          if (points.time_ns[s] < 0) {
+            continue;
+          }
+
+          if (prev >= 0) {
+            double ts  = points.time_ns[prev] / 1000.0;
+            double dur = (points.time_ns[s] - points.time_ns[prev]) / 1000.0;
+            fprintf(fp, "%s{\"ph\":\"X\",\"name\":\"%s\",\"cat\":\"pad\",\"pid\":%ld,\"tid\":%ld,"
+                        "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"seq\":%llu,\"code\":%u}}",
+                    first ? "" : ",\n", span_names[s], pid, points.tid[s], ts, dur,
+                    static_cast<unsigned long long>(entry.first), points.code);
+            first = false;
+          }
+          prev = s;
+        }
+      }
+
+      fprintf(fp, "\n]}\n");
+      fclose(fp);
+      return true;
+    }
+  }
+}
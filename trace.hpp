@@ -0,0 +1,106 @@
+#ifndef PAD_TRACE_H
+#define PAD_TRACE_H
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <atomic>
+#include <string>
+
+namespace pad {
+
+  namespace trace {
+
+    constexpr size_t DEFAULT_TRACE_CAPACITY = 1 << 16;
+    constexpr int    MAX_TRACE_THREADS = 4;   // 同時に記録できるスレッド数
+
+    // 1イベントがパイプラインを通過する計測点
+    enum class Stage : uint8_t {
+      Kernel,   // カーネルがイベントに付与したタイムスタンプ
+      Read,     // PadReader が read() した時刻
+      Decode,   // PadEventHandler がデコードを終えた時刻
+      Update,   // ButtonData / AxisData に反映した時刻
+      Consume   // アプリケーションが状態を読み出した時刻
+    };
+
+    struct TraceRecord {
+      uint64_t seq;     // イベント通し番号 (Consume では範囲の先頭)
+      uint32_t count;   // Consume でまとめて消費したイベント数
+      uint16_t code;
+      Stage    stage;
+      int64_t  time_ns; // CLOCK_MONOTONIC
+    };
+
+    namespace detail {
+      extern std::atomic<bool> enabled;
+    }
+
+    /**
+     * @brief start recording, `MAX_TRACE_THREADS` buffers of `capacity` records are allocated here
+     *
+     * a thread takes one of them on its first traced event (no allocation on the recording thread).
+     * buffers in use by a thread keep their size until released.
+     */
+    void enable(size_t capacity = DEFAULT_TRACE_CAPACITY);
+    void disable();
+    void clear();
+
+    /**
+     * @brief return the buffer of this thread to the pool (call before the thread exits)
+     *
+     * recorded points are kept for `dumpChromeTrace()`, the next thread continues in the same buffer
+     */
+    void releaseThread();
+
+    /**
+     * @brief check tracing mode (a relaxed atomic load only)
+     *
+     */
+    inline bool isEnabled() {
+      return detail::enabled.load(std::memory_order_relaxed);
+    }
+
+    inline int64_t nowNs() {
+      timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    /**
+     * @brief assign a sequence number to a new event and record Kernel / Read stage
+     *
+     * @return sequence number, also kept as the current event of this thread
+     */
+    uint64_t beginEvent(const timeval& kernel_time, uint16_t code);
+
+    /**
+     * @brief record `stage` for the current event of this thread
+     *
+     */
+    void record(Stage stage);
+
+    /**
+     * @brief record consumption of events [first_seq, first_seq + count)
+     *
+     */
+    void recordConsume(uint64_t first_seq, uint32_t count);
+
+    uint64_t currentSeq();
+
+    /**
+     * @brief set the current event of this thread (event read on another thread)
+     *
+     */
+    void setCurrentSeq(uint64_t seq);
+
+    /**
+     * @brief write all recorded points as Chrome trace JSON (viewable in Perfetto)
+     *
+     * @note call after `disable()` or while no thread is recording
+     */
+    bool dumpChromeTrace(const std::string& path);
+  }
+}
+
+#endif // PAD_TRACE_H
@@ -0,0 +1,353 @@
+#ifndef PAD_TRANSPORT_H
+#define PAD_TRANSPORT_H
+
+#include "gamepad.hpp"
+
+namespace pad {
+
+  constexpr int   NUM_TRANSPORTS = 2;
+  constexpr int   MIN_LINK_FRAMES = 50;            // 比較に必要なフレーム数
+  constexpr float LINK_SWITCH_MARGIN = 0.8f;       // 新しい経路のスコアがこの倍率未満なら切り替え
+  constexpr int64_t LINK_IDLE_US = 100000;         // これ以上の間隔は無操作とみなし計測しない
+  constexpr int64_t LINK_RECONNECT_NS = 500000000; // 切断中の経路を開き直す間隔
+
+  enum class TransportID : uint8_t {
+    Primary   = 0,  // 通常は USB
+    Secondary = 1   // 通常は Bluetooth
+  };
+
+  struct LinkStats {
+    bool     connected;
+    uint64_t frames;
+    float    interval_us;  // SYN_REPORT 間隔の移動平均
+    float    jitter_us;    // 間隔の平均絶対偏差
+
+    float rateHz() const {
+      return (interval_us > 0.0f) ? 1000000.0f / interval_us : 0.0f;
+    }
+  };
+
+  /**
+   * @brief pad watching two device files of the same controller (e.g. USB and Bluetooth)
+   *
+   * both transports are read every `update()` into their own state, and the public state
+   * follows the transport with the shorter / steadier report interval.
+   * switching waits until both transports agree on button state, so no edge is emitted by it.
+   * when the active transport is lost, the other one is adopted at once without emitting edges.
+   * while no transport is connected, all buttons / axes read as released / 0.
+   */
+  template <typename Handler,
+    typename = std::enable_if_t<std::is_base_of<PadEventHandler, Handler>::value>>
+  class AutoTransportPad {
+   private:
+    struct Link {
+      std::string path;
+      PadReader   reader;
+      std::unique_ptr<PadEventHandler> handler;
+      ButtonData  buttons;
+      AxisData    axes;
+      LinkStats   stats;
+      int64_t     last_sync_us;
+      int64_t     last_open_ns;
+
+      Link(std::string devfile_path, int button_num, int axis_num):
+        path(devfile_path),
+        handler(std::make_unique<Handler>()),
+        buttons(button_num),
+        axes(axis_num),
+        stats({false, 0, 0.0f, 0.0f}),
+        last_sync_us(0),
+        last_open_ns(0)
+      {
+
+      }
+    };
+
+    std::unique_ptr<Link> links_[NUM_TRANSPORTS];
+    ButtonData buttons_;
+    AxisData   axes_;
+    int active_{0};
+    uint32_t switch_count_{0};
+
+    void dispatch(Link& link) {
+      switch (link.handler->getEventType()) {
+        case EventType::Button: link.buttons.update(*(link.handler)); break;
+        case EventType::Axis:   link.axes.update(*(link.handler));    break;
+        default: break;
+      }
+    }
+
+    // 切断された経路の状態は残さない (古い値を公開しない)
+    void drop(Link& link) {
+      link.stats.connected = false;
+      link.buttons.clearData();
+      link.axes.clearData();
+    }
+
+    /**
+     * @brief open device file and read current key / abs state into the link state
+     *
+     */
+    bool open(Link& link) {
+      link.last_open_ns = trace::nowNs();
+      link.reader.disconnect();
+      drop(link);
+
+      if (!link.reader.connect(link.path)) {
+        return false;
+      }
+
+      int fd = link.reader.getFd();
+      link.handler->onConnect(fd);
+      link.stats = {true, 0, 0.0f, 0.0f};
+      link.last_sync_us = 0;
+
+      // evdev は変化したときしか送らないため，開いた時点の状態を ioctl で取得する
+      // (ハンドラのイベント処理を通すと十字キーが離されたイベントになるため，状態を直接書き込む)
+      uint8_t key_bits[KEY_CNT / 8 + 1];
+      memset(key_bits, 0, sizeof(key_bits));
+      ioctl(fd, EVIOCGKEY(sizeof(key_bits)), key_bits);
+
+      for (int code = 0; code < KEY_CNT; code++) {
+        if ((key_bits[code / 8] >> (code % 8)) & 1) {
+          uint8_t id = link.handler->buttonId(code);
+          if (id != INVALID_ID) {
+            link.buttons.assignState(id, true);
+          }
+        }
+      }
+
+      for (int code = 0; code < ABS_CNT; code++) {
+        input_absinfo absinfo;
+        if (ioctl(fd, EVIOCGABS(code), &absinfo) < 0) {
+          continue;
+        }
+
+        if (code >= ABS_HAT0X && code <= ABS_HAT3Y) {
+          uint8_t id = link.handler->hatButtonId(code, absinfo.value);
+          if (id != INVALID_ID) {
+            // 後で離されたときに正しい十字キーになるよう，ハンドラにも押された向きを渡す (出力は使わない)
+            link.handler->handleEvent(PadEvent{EventType::Axis, static_cast<uint16_t>(code), absinfo.value});
+            link.buttons.assignState(id, true);
+          }
+          continue;
+        }
+
+        link.handler->handleEvent(PadEvent{EventType::Axis, static_cast<uint16_t>(code), absinfo.value});
+        if (link.handler->getEventType() == EventType::Axis) {
+          link.axes.update(*(link.handler));
+        }
+      }
+
+      link.buttons.clearEvents();
+      return true;
+    }
+
+    void read(Link& link) {
+      link.buttons.clearEvents();
+
+      if (!link.reader.isConnected()) {
+        if (link.stats.connected) {
+          drop(link);
+        }
+        if (trace::nowNs() - link.last_open_ns >= LINK_RECONNECT_NS) {
+          open(link);
+        }
+        return;
+      }
+
+      while (true) {
+        if (link.reader.readEvent()) {
+          link.handler->handleEvent(link.reader);
+          dispatch(link);
+          continue;
+        }
+
+        if (!link.reader.isSync()) {
+          break;
+        }
+
+        // SYN_REPORT の間隔から報告レートとジッタを計測
+        int64_t sync_us = link.reader.getSyncTime();
+        int64_t interval = sync_us - link.last_sync_us;
+        if (link.last_sync_us != 0 && interval > 0 && interval < LINK_IDLE_US) {
+          LinkStats& stats = link.stats;
+          if (stats.frames == 0) {
+            stats.interval_us = interval;
+          }
+          float deviation = fabs(interval - stats.interval_us);
+          stats.interval_us += (interval - stats.interval_us) / 16.0f;
+          stats.jitter_us   += (deviation - stats.jitter_us) / 16.0f;
+          stats.frames++;
+        }
+        link.last_sync_us = sync_us;
+      }
+
+      if (!link.reader.isConnected()) {
+        drop(link);
+      }
+    }
+
+    float score(const Link& link) {
+      return link.stats.interval_us + 2.0f * link.stats.jitter_us;
+    }
+
+    int selectLink() {
+      Link& active = *(links_[active_]);
+      int other = 1 - active_;
+      Link& candidate = *(links_[other]);
+
+      if (!candidate.stats.connected) {
+        return active_;
+      }
+
+      if (!active.stats.connected) {
+        return other;
+      }
+
+      if (candidate.stats.frames < MIN_LINK_FRAMES) {
+        return active_;
+      }
+
+      if (active.stats.frames < MIN_LINK_FRAMES
+          || score(candidate) < score(active) * LINK_SWITCH_MARGIN) {
+        return other;
+      }
+
+      return active_;
+    }
+
+    bool sameButtons(Link& a, Link& b) {
+      const std::vector<bool>& x = a.buttons.getData();
+      const std::vector<bool>& y = b.buttons.getData();
+      for (size_t i = 0; i < x.size(); i++) {
+        if (x[i] != y[i]) return false;
+      }
+      return true;
+    }
+
+    // 採用中の経路の状態を公開用の状態へ反映
+    // 通常はその経路の今回のボタンイベントをそのまま渡す (1 回の update() 中に押して離しても失われない)
+    // `silent` (経路の引き継ぎ) では状態だけを書き換え，イベントにしない
+    void publish(Link& link, bool silent) {
+      if (silent) {
+        const std::vector<bool>& src = link.buttons.getData();
+        for (size_t i = 0; i < src.size(); i++) {
+          this->buttons_.assignState(i, src[i]);
+        }
+      }
+      else {
+        this->buttons_.copyFrom(link.buttons);
+      }
+
+      const std::vector<float>& axes = link.axes.getData();
+      for (size_t i = 0; i < axes.size(); i++) {
+        this->axes_.setValue(i, axes[i]);
+      }
+    }
+
+   public:
+    AutoTransportPad(std::string primary_path,
+                     std::string secondary_path,
+                     int button_num = DEFAULT_BUTTON_NUM,
+                     int axis_num = DEFALUT_AXIS_NUM):
+      buttons_(button_num),
+      axes_(axis_num)
+    {
+      this->links_[0] = std::make_unique<Link>(primary_path, button_num, axis_num);
+      this->links_[1] = std::make_unique<Link>(secondary_path, button_num, axis_num);
+
+      for (auto& link: this->links_) {
+        open(*link);
+      }
+
+      if (!this->links_[0]->reader.isConnected() && this->links_[1]->reader.isConnected()) {
+        this->active_ = 1;
+      }
+      publish(*(this->links_[this->active_]), true);
+    }
+
+    bool isConnected() {
+      return this->links_[0]->reader.isConnected() || this->links_[1]->reader.isConnected();
+    }
+
+    void setDeadZone(float deadzone) {
+      for (auto& link: this->links_) {
+        link->handler->setDeadZone(deadzone);
+      }
+    }
+
+    TransportID getActiveTransport() {
+      return static_cast<TransportID>(this->active_);
+    }
+
+    LinkStats getLinkStats(TransportID id) {
+      return this->links_[static_cast<int>(id)]->stats;
+    }
+
+    uint32_t getSwitchCount() {
+      return this->switch_count_;
+    }
+
+    void update() {
+      this->buttons_.clearEvents();
+
+      for (auto& link: this->links_) {
+        read(*link);
+      }
+
+      // どちらの経路もつながっていなければ，BasePad と同様に状態を消す
+      if (!this->links_[0]->stats.connected && !this->links_[1]->stats.connected) {
+        this->buttons_.clearData();
+        this->axes_.clearData();
+        return;
+      }
+
+      int next = selectLink();
+      bool silent = false;
+
+      if (next != this->active_) {
+        Link& active = *(this->links_[this->active_]);
+        Link& candidate = *(this->links_[next]);
+
+        // 切断時は即座に (状態の差はイベントにしない)，そうでなければボタン状態が一致するまで待つ
+        if (!active.stats.connected) {
+          silent = true;
+        }
+
+        if (silent || sameButtons(active, candidate)) {
+          this->active_ = next;
+          this->switch_count_++;
+        }
+      }
+
+      publish(*(this->links_[this->active_]), silent);
+    }
+
+    std::vector<bool> getButtonVec() {
+      return this->buttons_.getVector();
+    }
+
+    std::vector<float> getAxisVec() {
+      return this->axes_.getVector();
+    }
+
+    bool press(uint8_t id) {
+      return this->buttons_.getState(id);
+    }
+
+    bool pushed(uint8_t id) {
+      return this->buttons_.pushed(id);
+    }
+
+    bool released(uint8_t id) {
+      return this->buttons_.released(id);
+    }
+
+    float axisValue(uint8_t id) {
+      return this->axes_.getValue(id);
+    }
+  };
+}
+
+#endif // PAD_TRANSPORT_H